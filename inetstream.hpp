@@ -8,9 +8,19 @@
 #include <array>
 #include <type_traits>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <atomic>
 // C
 #include <cstring>
 #include <cerrno>
+#include <climits>
 // System
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -20,6 +30,24 @@
 #include <netdb.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sched.h>
+#include <pthread.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define INET_X86_SIMD 1
+#include <immintrin.h>
+#endif
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#ifdef INET_USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
 
 // users may override these
 #ifndef INET_MAX_CONNECTIONS
@@ -33,11 +61,79 @@
 #ifndef INET_MAX_RECV_TIMEOUT_MS
 #define INET_MAX_RECV_TIMEOUT_MS 1000
 #endif
+
+// how long client::connect() tries by default, and how long it waits for
+// one address before it tries the next one in parallel
+#ifndef INET_CONNECT_TIMEOUT_MS
+#define INET_CONNECT_TIMEOUT_MS 5000
+#endif
+#ifndef INET_CONNECT_STAGGER_MS
+#define INET_CONNECT_STAGGER_MS 250
+#endif
+// upper bound for the payload of a length-prefixed message, larger length
+// headers are treated as garbage
+#ifndef INET_MAX_MESSAGE_SIZE
+#define INET_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+#endif
+
+// number of bytes a single read into the stream may take, see
+// inetstream::set_read_size()
+#ifndef INET_DEFAULT_READ_SIZE
+#define INET_DEFAULT_READ_SIZE (64 * 1024)
+#endif
+
+// upper bound for the read size when it grows adaptively
+#ifndef INET_MAX_READ_SIZE
+#define INET_MAX_READ_SIZE (4 * 1024 * 1024)
+#endif
+
+// bytes a single recv_batch() sets aside for the datagrams it receives
+#ifndef INET_MAX_BATCH_SIZE
+#define INET_MAX_BATCH_SIZE (1024 * 1024)
+#endif
+
+// sends of at least this many bytes use MSG_ZEROCOPY once enabled by
+// inetstream::set_zerocopy(), smaller ones are cheaper to copy
+#ifndef INET_ZEROCOPY_MIN_SIZE
+#define INET_ZEROCOPY_MIN_SIZE (64 * 1024)
+#endif
+// bytes send_file() and recv_to_file() move per step, progress is reported
+// after each step
+#ifndef INET_FILE_CHUNK_SIZE
+#define INET_FILE_CHUNK_SIZE (1024 * 1024)
+#endif
+// chunk sizes and the number of idle bytes a buffer_pool keeps for reuse
+#ifndef INET_POOL_MIN_CHUNK
+#define INET_POOL_MIN_CHUNK (4 * 1024)
+#endif
+
+#ifndef INET_POOL_MAX_CHUNK
+#define INET_POOL_MAX_CHUNK (4 * 1024 * 1024)
+#endif
+
+#ifndef INET_POOL_MAX_IDLE
+#define INET_POOL_MAX_IDLE (64 * 1024 * 1024)
+#endif
+// messages sent by send_message() are only compressed from this size on,
+// see inetstream::set_codec()
+#ifndef INET_COMPRESS_MIN_SIZE
+#define INET_COMPRESS_MIN_SIZE 512
+#endif
 // set to 6 to use IPv6 instead of IPv4
 #ifndef INET_IPV
 #define INET_IPV 4
 #endif
 
+// queue depth and number of fixed file slots of an inet::uring, which is
+// only available if INET_USE_IO_URING is defined before inclusion
+#ifndef INET_URING_ENTRIES
+#define INET_URING_ENTRIES 256
+#endif
+
+#ifndef INET_URING_FILES
+#define INET_URING_FILES 1024
+#endif
+
 #ifndef INET_USE_DEFAULT_SIGUSR1_HANDLER
 #define INET_USE_DEFAULT_SIGUSR1_HANDLER false
 #endif
@@ -61,6 +157,335 @@ inline void* get_in_addr(sockaddr* sa) {
 }
 typedef unsigned char byte;
 
+/**
+ * slab pool that recycles the memory of stream buffers. requests are
+ * rounded up to power of two chunks from min_chunk to max_chunk bytes, freed
+ * chunks are kept for reuse while fewer than max_idle bytes are idle. larger
+ * requests go straight to the heap.
+ *
+ * a server shares one pool between all streams it accepts. it is thread
+ * safe, and subclasses may override allocate() and deallocate() to plug in
+ * a different strategy.
+ */
+class buffer_pool {
+public:
+	explicit buffer_pool(std::size_t min_chunk = INET_POOL_MIN_CHUNK,
+	                     std::size_t max_chunk = INET_POOL_MAX_CHUNK,
+	                     std::size_t max_idle = INET_POOL_MAX_IDLE)
+		: _min_chunk {std::max<std::size_t>(min_chunk, 1)}, _max_chunk {max_chunk},
+		  _max_idle {max_idle}, _idle {0}
+	{
+		std::size_t classes {1};
+		while ((_min_chunk << (classes - 1)) < _max_chunk) {
+			++classes;
+		}
+		_free.resize(classes);
+	}
+	buffer_pool(const buffer_pool&) = delete;
+	buffer_pool& operator=(const buffer_pool&) = delete;
+	virtual ~buffer_pool() {
+		for (auto& chunks : _free) {
+			for (void* p : chunks) {
+				::operator delete(p);
+			}
+		}
+	}
+	virtual void* allocate(std::size_t sz) {
+		std::size_t c = this->size_class(sz);
+		if (c == _free.size()) {
+			return ::operator new(sz);
+		}
+		{
+			std::lock_guard<std::mutex> lock {_mutex};
+			if (!_free[c].empty()) {
+				void* p = _free[c].back();
+				_free[c].pop_back();
+				_idle -= _min_chunk << c;
+				return p;
+			}
+		}
+		return ::operator new(_min_chunk << c);
+	}
+	virtual void deallocate(void* p, std::size_t sz) {
+		std::size_t c = this->size_class(sz);
+		if (c < _free.size()) {
+			std::lock_guard<std::mutex> lock {_mutex};
+			if (_idle + (_min_chunk << c) <= _max_idle) {
+				_free[c].push_back(p);
+				_idle += _min_chunk << c;
+				return;
+			}
+		}
+		::operator delete(p);
+	}
+	/**
+	 * @return number of bytes kept for reuse
+	 */
+	std::size_t idle() const {
+		std::lock_guard<std::mutex> lock {_mutex};
+		return _idle;
+	}
+private:
+	// index into _free, or _free.size() if sz is too large to pool
+	std::size_t size_class(std::size_t sz) const {
+		if (sz > _max_chunk) {
+			return _free.size();
+		}
+		std::size_t c {0};
+		while ((_min_chunk << c) < sz) {
+			++c;
+		}
+		return c;
+	}
+	const std::size_t _min_chunk;
+	const std::size_t _max_chunk;
+	const std::size_t _max_idle;
+	mutable std::mutex _mutex;
+	std::vector<std::vector<void*>> _free;
+	std::size_t _idle;
+};
+
+/**
+ * allocator of stream buffers, takes memory from a buffer_pool or the heap
+ * if it has none
+ *
+ * it default- instead of value-initializes elements. growing a buffer then
+ * does not zero bytes that are overwritten right away, and appending a few
+ * bytes compiles down to plain stores instead of memmove.
+ */
+template <typename T>
+struct pool_allocator {
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+	pool_allocator() = default;
+	explicit pool_allocator(std::shared_ptr<buffer_pool> p) : pool {std::move(p)} {}
+	template <typename U> pool_allocator(const pool_allocator<U>& other) : pool {other.pool} {}
+	T* allocate(std::size_t n) {
+		if (pool) {
+			return static_cast<T*>(pool->allocate(n * sizeof(T)));
+		}
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+	void deallocate(T* p, std::size_t n) {
+		if (pool) {
+			pool->deallocate(p, n * sizeof(T));
+			return;
+		}
+		::operator delete(p);
+	}
+	template <typename U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+	template <typename U, typename... Args> void construct(U* p, Args&&... args) {
+		::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+	std::shared_ptr<buffer_pool> pool;
+};
+template <typename T, typename U>
+bool operator==(const pool_allocator<T>& a, const pool_allocator<U>& b) { return a.pool == b.pool; }
+template <typename T, typename U>
+bool operator!=(const pool_allocator<T>& a, const pool_allocator<U>& b) { return a.pool != b.pool; }
+typedef std::vector<byte, pool_allocator<byte>> buffer;
+
+/**
+ * blocks until fd is ready for events or deadline passed, without spinning
+ *
+ * @return true if fd is ready, false if deadline passed
+ *
+ * @throws std::system_error if ::ppoll() encounters an error
+ */
+inline bool wait_ready(int fd, short events, std::chrono::steady_clock::time_point deadline) {
+	auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		deadline - std::chrono::steady_clock::now());
+	if (left.count() < 0) {
+		left = std::chrono::nanoseconds {0};
+	}
+	timespec ts {};
+	ts.tv_sec = static_cast<time_t>(left.count() / 1000000000);
+	ts.tv_nsec = static_cast<long>(left.count() % 1000000000);
+	pollfd pfd {};
+	pfd.fd = fd;
+	pfd.events = events;
+	int rv = ::ppoll(&pfd, 1, &ts, nullptr);
+	if (rv < 0) {
+		throw std::system_error {errno, std::system_category(), strerror(errno)};
+	}
+	return rv > 0;
+}
+
+/**
+ * copies count elements of W bytes each from src to dst, reversing the
+ * byte order of every element
+ */
+template <std::size_t W>
+inline void swap_copy_scalar(byte* dst, const byte* src, std::size_t count) {
+	for (std::size_t i {0}; i < count; ++i) {
+		for (std::size_t b {0}; b < W; ++b) {
+			dst[i * W + b] = src[i * W + W - 1 - b];
+		}
+	}
+}
+#ifdef INET_X86_SIMD
+// pshufb mask reversing every W byte element of a 16 byte lane
+template <std::size_t W>
+inline void swap_mask(byte (&mask)[32]) {
+	for (std::size_t k {0}; k < 32; ++k) {
+		mask[k] = static_cast<byte>((k % 16) / W * W + W - 1 - k % W);
+	}
+}
+/**
+ * @return number of elements copied, the rest is left to swap_copy_scalar
+ */
+template <std::size_t W>
+__attribute__((target("avx2")))
+std::size_t swap_copy_avx2(byte* dst, const byte* src, std::size_t count) {
+	byte m[32];
+	swap_mask<W>(m);
+	const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m));
+	std::size_t n = count * W, i {0};
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v, mask));
+	}
+	return i / W;
+}
+template <std::size_t W>
+__attribute__((target("ssse3")))
+std::size_t swap_copy_ssse3(byte* dst, const byte* src, std::size_t count) {
+	byte m[32];
+	swap_mask<W>(m);
+	const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m));
+	std::size_t n = count * W, i {0};
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, mask));
+	}
+	return i / W;
+}
+#endif
+/**
+ * copies count elements of W bytes each from src to dst, converting
+ * between host and network byte order. uses AVX2 or SSSE3 byte shuffles
+ * if the cpu supports them and degrades to memcpy on big endian hosts.
+ */
+template <std::size_t W>
+inline void swap_copy(byte* dst, const byte* src, std::size_t count) {
+	// empty arrays and buffers may hand out null, which memcpy must not get
+	if (count == 0) {
+		return;
+	}
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	std::memcpy(dst, src, count * W);
+#else
+	if (W == 1) {
+		std::memcpy(dst, src, count);
+		return;
+	}
+	std::size_t done {0};
+#ifdef INET_X86_SIMD
+	static const int simd = __builtin_cpu_supports("avx2") ? 2 :
+	                        __builtin_cpu_supports("ssse3") ? 1 : 0;
+	if (simd == 2) {
+		done = swap_copy_avx2<W>(dst, src, count);
+	}
+	else if (simd == 1) {
+		done = swap_copy_ssse3<W>(dst, src, count);
+	}
+#endif
+	swap_copy_scalar<W>(dst + done * W, src + done * W, count - done);
+#endif
+}
+
+/**
+ * lookup table for the reflected CRC32C (Castagnoli) polynomial
+ */
+inline const uint32_t* crc32c_table() {
+	struct table {
+		uint32_t t[256];
+		table() {
+			for (uint32_t i {0}; i < 256; ++i) {
+				uint32_t c {i};
+				for (int k {0}; k < 8; ++k) {
+					c = (c >> 1) ^ (c & 1 ? 0x82F63B78u : 0);
+				}
+				t[i] = c;
+			}
+		}
+	};
+	static const table tbl;
+	return tbl.t;
+}
+/**
+ * table driven CRC32C of n bytes at p, crc is the pre-inverted state
+ */
+inline uint32_t crc32c_scalar(const byte* p, std::size_t n, uint32_t crc) {
+	const uint32_t* t = crc32c_table();
+	for (std::size_t i {0}; i < n; ++i) {
+		crc = t[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+#ifdef INET_X86_SIMD
+__attribute__((target("sse4.2")))
+inline uint32_t crc32c_sse42(const byte* p, std::size_t n, uint32_t crc) {
+#ifdef __x86_64__
+	uint64_t c {crc};
+	for (; n >= 8; p += 8, n -= 8) {
+		uint64_t v;
+		std::memcpy(&v, p, 8);
+		c = _mm_crc32_u64(c, v);
+	}
+	crc = static_cast<uint32_t>(c);
+#endif
+	for (; n >= 4; p += 4, n -= 4) {
+		uint32_t v;
+		std::memcpy(&v, p, 4);
+		crc = _mm_crc32_u32(crc, v);
+	}
+	for (; n > 0; ++p, --n) {
+		crc = _mm_crc32_u8(crc, *p);
+	}
+	return crc;
+}
+#endif
+/**
+ * CRC32C (Castagnoli) checksum of n bytes at p as used by iSCSI and ext4.
+ * uses the SSE4.2 crc32 instruction if the cpu supports it. pass the
+ * previous result as crc to continue a checksum over several buffers.
+ */
+inline uint32_t crc32c(const void* p, std::size_t n, uint32_t crc = 0) {
+	const byte* b = static_cast<const byte*>(p);
+	crc = ~crc;
+#ifdef INET_X86_SIMD
+	static const bool sse42 = __builtin_cpu_supports("sse4.2");
+	if (sse42) {
+		return ~crc32c_sse42(b, n, crc);
+	}
+#endif
+	return ~crc32c_scalar(b, n, crc);
+}
+
+/**
+ * non-owning view of bytes received by an inetstream, see
+ * inetstream::read_view()
+ */
+class view {
+public:
+	view() : _p {nullptr}, _sz {0} {}
+	view(const byte* p, std::size_t sz) : _p {p}, _sz {sz} {}
+	const byte* data() const { return _p; }
+	const char* chars() const { return reinterpret_cast<const char*>(_p); }
+	std::size_t size() const { return _sz; }
+	bool empty() const { return _sz == 0; }
+	const byte* begin() const { return _p; }
+	const byte* end() const { return _p + _sz; }
+	byte operator[](std::size_t i) const { return _p[i]; }
+	std::string str() const { return std::string(this->chars(), _sz); }
+private:
+	const byte* _p;
+	std::size_t _sz;
+};
+
 enum class protocol {
 	TCP, UDP
 };
@@ -69,28 +494,611 @@ template <protocol P> struct is_tcp_prot { static constexpr const bool value = s
 template <> struct is_tcp_prot<protocol::TCP> { static constexpr const bool value = std::true_type::value; };
 template <protocol P> struct is_udp_prot { static constexpr const bool value = std::false_type::value; };
 template <> struct is_udp_prot<protocol::UDP> { static constexpr const bool value = std::true_type::value; };
+// arithmetic types write_array() and read_array() can convert
+template <typename T> struct is_array_elem {
+	static constexpr const bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+		(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+};
+template <typename T> struct is_elem_container { static constexpr const bool value = false; };
+template <typename T, typename A> struct is_elem_container<std::vector<T, A>> {
+	static constexpr const bool value = is_array_elem<T>::value;
+};
+template <typename T, std::size_t N> struct is_elem_container<std::array<T, N>> {
+	static constexpr const bool value = is_array_elem<T>::value;
+};
+
+/**
+ * member m of C, part of a schema
+ */
+template <typename C, typename M, M C::*Ptr>
+struct field {
+	typedef M type;
+	static const M& get(const C& c) { return c.*Ptr; }
+	static M& get(C& c) { return c.*Ptr; }
+};
+// detects schemas declared with INET_SCHEMA, found by argument dependent lookup
+template <typename T> struct has_schema {
+	template <typename U>
+	static auto test(int) -> decltype(inet_schema(static_cast<const U*>(nullptr)), std::true_type {});
+	template <typename U> static std::false_type test(...);
+	static constexpr const bool value = decltype(test<T>(0))::value;
+};
+template <typename T> struct schema_of { typedef decltype(inet_schema(static_cast<const T*>(nullptr))) type; };
+
+/**
+ * how a value of type T goes over the wire. fixed types always take size
+ * bytes, for the others size is the minimum.
+ */
+template <typename T, typename = void> struct wire;
+// integers and floating point numbers, in network byte order
+template <typename T>
+struct wire<T, typename std::enable_if<is_array_elem<T>::value>::type> {
+	static constexpr const bool fixed = true;
+	static constexpr const std::size_t size = sizeof(T);
+	static std::size_t size_of(const T&) { return size; }
+	static byte* encode(byte* p, const T& v) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::memcpy(p, &v, size);
+#else
+		swap_copy_scalar<size>(p, reinterpret_cast<const byte*>(&v), 1);
+#endif
+		return p + size;
+	}
+	static const byte* decode(const byte* p, const byte*, T& v) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::memcpy(&v, p, size);
+#else
+		swap_copy_scalar<size>(reinterpret_cast<byte*>(&v), p, 1);
+#endif
+		return p + size;
+	}
+};
+template <>
+struct wire<bool> {
+	static constexpr const bool fixed = true;
+	static constexpr const std::size_t size = 1;
+	static std::size_t size_of(const bool&) { return size; }
+	static byte* encode(byte* p, const bool& v) {
+		*p = v ? 1 : 0;
+		return p + 1;
+	}
+	static const byte* decode(const byte* p, const byte*, bool& v) {
+		v = *p != 0;
+		return p + 1;
+	}
+};
+// enums as their underlying type
+template <typename T>
+struct wire<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+	typedef typename std::underlying_type<T>::type U;
+	static constexpr const bool fixed = true;
+	static constexpr const std::size_t size = sizeof(U);
+	static std::size_t size_of(const T&) { return size; }
+	static byte* encode(byte* p, const T& v) { return wire<U>::encode(p, static_cast<U>(v)); }
+	static const byte* decode(const byte* p, const byte* end, T& v) {
+		U u {};
+		p = wire<U>::decode(p, end, u);
+		v = static_cast<T>(u);
+		return p;
+	}
+};
+// std::array of numbers, converted as one block
+template <typename T, std::size_t N>
+struct wire<std::array<T, N>, typename std::enable_if<is_array_elem<T>::value>::type> {
+	static constexpr const bool fixed = true;
+	static constexpr const std::size_t size = N * sizeof(T);
+	static std::size_t size_of(const std::array<T, N>&) { return size; }
+	static byte* encode(byte* p, const std::array<T, N>& v) {
+		swap_copy<sizeof(T)>(p, reinterpret_cast<const byte*>(v.data()), N);
+		return p + size;
+	}
+	static const byte* decode(const byte* p, const byte*, std::array<T, N>& v) {
+		swap_copy<sizeof(T)>(reinterpret_cast<byte*>(v.data()), p, N);
+		return p + size;
+	}
+};
+// strings, prefixed with their length as 32 bit unsigned integer
+template <>
+struct wire<std::string> {
+	static constexpr const bool fixed = false;
+	static constexpr const std::size_t size = sizeof(uint32_t);
+	static std::size_t size_of(const std::string& s) { return size + s.size(); }
+	static byte* encode(byte* p, const std::string& s) {
+		if (s.size() > std::numeric_limits<uint32_t>::max()) {
+			throw std::length_error {"string too long for its 32 bit length"};
+		}
+		p = wire<uint32_t>::encode(p, static_cast<uint32_t>(s.size()));
+		std::memcpy(p, s.data(), s.size());
+		return p + s.size();
+	}
+	static const byte* decode(const byte* p, const byte* end, std::string& s) {
+		uint32_t len {};
+		p = wire<uint32_t>::decode(p, end, len);
+		if (static_cast<std::size_t>(end - p) < len) {
+			throw std::runtime_error {"string exceeds the received data"};
+		}
+		s.assign(reinterpret_cast<const char*>(p), len);
+		return p + len;
+	}
+};
+/**
+ * a list of fields, encoded one after the other without padding
+ */
+template <typename... F> struct schema;
+template <>
+struct schema<> {
+	static constexpr const bool fixed = true;
+	static constexpr const std::size_t size = 0;
+	template <typename C> static std::size_t size_of(const C&) { return 0; }
+	template <typename C> static byte* encode(byte* p, const C&) { return p; }
+	template <typename C> static const byte* decode(const byte* p, const byte*, C&) { return p; }
+};
+template <typename F, typename... R>
+struct schema<F, R...> {
+	typedef wire<typename F::type> head;
+	typedef schema<R...> tail;
+	static constexpr const bool fixed = head::fixed && tail::fixed;
+	static constexpr const std::size_t size = head::size + tail::size;
+	template <typename C> static std::size_t size_of(const C& c) {
+		return fixed ? size : head::size_of(F::get(c)) + tail::size_of(c);
+	}
+	template <typename C> static byte* encode(byte* p, const C& c) {
+		return tail::encode(head::encode(p, F::get(c)), c);
+	}
+	template <typename C> static const byte* decode(const byte* p, const byte* end, C& c) {
+		// fixed fields are not checked one by one, so the minimum of what
+		// follows has to be there before and after every variable field
+		if (!fixed && static_cast<std::size_t>(end - p) < size) {
+			throw std::runtime_error {"struct exceeds the received data"};
+		}
+		p = head::decode(p, end, F::get(c));
+		if (!head::fixed && static_cast<std::size_t>(end - p) < tail::size) {
+			throw std::runtime_error {"struct exceeds the received data"};
+		}
+		return tail::decode(p, end, c);
+	}
+};
+// structs with a schema, so they can nest
+template <typename T>
+struct wire<T, typename std::enable_if<has_schema<T>::value>::type> : schema_of<T>::type {};
+
+/**
+ * describe the members of a struct once to send it with operator<< and
+ * receive it with operator>>, packed and in network byte order. use next
+ * to the struct, in the same namespace:
+ *
+ *   struct point { int32_t x, y; };
+ *   INET_SCHEMA(point, INET_FIELD(point, x), INET_FIELD(point, y));
+ *
+ * members may be numbers, bools, enums, std::arrays of numbers, strings or
+ * structs with a schema of their own. inet::wire<point>::size is the
+ * encoded size, known at compile time if inet::wire<point>::fixed.
+ */
+#define INET_FIELD(C, m) ::inet::field<C, decltype(C::m), &C::m>
+#define INET_SCHEMA(C, ...) \
+	inline ::inet::schema<__VA_ARGS__> inet_schema(const C*) { return {}; }
+
+// integers varint() can encode
+template <typename T> struct is_varint_elem {
+	static constexpr const bool value = std::is_integral<T>::value && !std::is_same<T, bool>::value;
+};
+/**
+ * wrappers returned by varint(), an integer to push or one to read into
+ */
+template <typename T> struct varint_value { T v; };
+template <typename T> struct varint_ref { T& v; };
+/**
+ * send x as LEB128 varint instead of its fixed size, 7 bits per byte, so
+ * small values take a single byte. signed integers are zigzag encoded
+ * first, which keeps small negative values small as well.
+ *
+ *   istr << inet::varint(id);
+ *   istr >> inet::varint(id);
+ */
+template <typename T>
+typename std::enable_if<is_varint_elem<T>::value, varint_ref<T>>::type varint(T& x) { return {x}; }
+template <typename T>
+typename std::enable_if<is_varint_elem<T>::value, varint_value<T>>::type varint(const T& x) { return {x}; }
+
+template <typename T>
+typename std::enable_if<std::is_signed<T>::value, uint64_t>::type zigzag(T x) {
+	return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(x) >> 63);
+}
+template <typename T>
+typename std::enable_if<!std::is_signed<T>::value, uint64_t>::type zigzag(T x) {
+	return x;
+}
+/**
+ * @return false if x does not fit into T, t is left untouched then
+ */
+template <typename T>
+typename std::enable_if<std::is_signed<T>::value, bool>::type unzigzag(uint64_t x, T& t) {
+	int64_t v = static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1);
+	if (v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max()) {
+		return false;
+	}
+	t = static_cast<T>(v);
+	return true;
+}
+template <typename T>
+typename std::enable_if<!std::is_signed<T>::value, bool>::type unzigzag(uint64_t x, T& t) {
+	if (x > std::numeric_limits<T>::max()) {
+		return false;
+	}
+	t = static_cast<T>(x);
+	return true;
+}
+// longest encoding of a 64 bit varint
+constexpr const std::size_t max_varint_size {10};
+/**
+ * writes v to p, which needs room for max_varint_size bytes
+ *
+ * @return end of the encoding
+ */
+inline byte* varint_encode(byte* p, uint64_t v) {
+	while (v >= 0x80) {
+		*p++ = static_cast<byte>(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = static_cast<byte>(v);
+	return p;
+}
+/**
+ * reads a varint from [p, end). up to 8 bytes long ones are decoded from a
+ * single load without a branch per byte.
+ *
+ * @return number of bytes consumed, 0 if the varint is incomplete or
+ * longer than 64 bits
+ */
+inline std::size_t varint_decode(const byte* p, const byte* end, uint64_t& v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (end - p >= 8) {
+		uint64_t w;
+		std::memcpy(&w, p, sizeof w);
+		uint64_t stops = ~w & 0x8080808080808080ULL;
+		if (stops != 0) {
+			std::size_t n = static_cast<std::size_t>(__builtin_ctzll(stops)) / 8 + 1;
+			uint64_t x = w & (~0ULL >> (64 - 8 * n)) & 0x7f7f7f7f7f7f7f7fULL;
+			// squeeze out the continuation bits, 7 to 14 to 28 to 56 bits
+			x = (x & 0x007f007f007f007fULL) | ((x & 0x7f007f007f007f00ULL) >> 1);
+			x = (x & 0x00003fff00003fffULL) | ((x & 0x3fff00003fff0000ULL) >> 2);
+			x = (x & 0x000000000fffffffULL) | ((x & 0x0fffffff00000000ULL) >> 4);
+			v = x;
+			return n;
+		}
+	}
+#endif
+	uint64_t x {0};
+	for (std::size_t i {0}; i < max_varint_size && p + i < end; ++i) {
+		x |= static_cast<uint64_t>(p[i] & 0x7f) << (7 * i);
+		if ((p[i] & 0x80) == 0) {
+			if (i == max_varint_size - 1 && p[i] > 1) {
+				return 0;
+			}
+			v = x;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * compression stage for messages, see inetstream::set_codec(). every
+ * compressed message names the codec by id, so ids have to be unique.
+ */
+class codec {
+public:
+	virtual ~codec() = default;
+	virtual byte id() const = 0;
+	// upper bound for the output of compress() for n input bytes
+	virtual std::size_t max_compressed_size(std::size_t n) const = 0;
+	/**
+	 * @return number of bytes written to dst
+	 */
+	virtual std::size_t compress(const byte* src, std::size_t n, byte* dst) const = 0;
+	/**
+	 * @return false unless src holds a valid encoding of exactly out_n bytes
+	 */
+	virtual bool decompress(const byte* src, std::size_t n, byte* dst, std::size_t out_n) const = 0;
+};
+/**
+ * fast LZ77 codec in the spirit of the LZ4 block format. sequences of
+ * literals and matches up to 64 KB back are found through a small hash
+ * table of 4 byte prefixes, so it trades ratio for speed.
+ */
+class lz_codec : public codec {
+public:
+	byte id() const override { return 1; }
+	std::size_t max_compressed_size(std::size_t n) const override { return n + n / 255 + 16; }
+	std::size_t compress(const byte* src, std::size_t n, byte* dst) const override {
+		uint32_t table[1 << hash_log] = {};
+		byte* op = dst;
+		std::size_t ip {0}, anchor {0};
+		// the last 5 bytes are always literals, which the decoder relies on
+		const std::size_t match_limit = n > 12 ? n - 12 : 0;
+		while (ip < match_limit) {
+			uint32_t seq = read32(src + ip);
+			uint32_t h = (seq * 2654435761u) >> (32 - hash_log);
+			std::size_t ref = table[h];
+			table[h] = static_cast<uint32_t>(ip);
+			if (ref >= ip || ip - ref > 0xffff || read32(src + ref) != seq) {
+				// skip faster through data that does not compress
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			std::size_t len {4};
+			while (ip + len < n - 5 && src[ref + len] == src[ip + len]) {
+				++len;
+			}
+			op = emit(op, src + anchor, ip - anchor, ip - ref, len);
+			ip += len;
+			anchor = ip;
+		}
+		return emit(op, src + anchor, n - anchor, 0, 0) - dst;
+	}
+	bool decompress(const byte* src, std::size_t n, byte* dst, std::size_t out_n) const override {
+		const byte* ip = src;
+		const byte* const iend = src + n;
+		byte* op = dst;
+		byte* const oend = dst + out_n;
+		while (ip < iend) {
+			unsigned token = *ip++;
+			std::size_t lit = token >> 4;
+			if (lit == 15 && !get_len(ip, iend, lit)) {
+				return false;
+			}
+			if (lit > static_cast<std::size_t>(iend - ip) || lit > static_cast<std::size_t>(oend - op)) {
+				return false;
+			}
+			std::memcpy(op, ip, lit);
+			ip += lit;
+			op += lit;
+			if (ip == iend) {
+				// the last sequence has no match
+				break;
+			}
+			if (iend - ip < 2) {
+				return false;
+			}
+			std::size_t offset = ip[0] | static_cast<std::size_t>(ip[1]) << 8;
+			ip += 2;
+			std::size_t len = token & 15;
+			if (offset == 0 || offset > static_cast<std::size_t>(op - dst) ||
+			    (len == 15 && !get_len(ip, iend, len))) {
+				return false;
+			}
+			len += 4;
+			if (len > static_cast<std::size_t>(oend - op)) {
+				return false;
+			}
+			const byte* ref = op - offset;
+			if (offset >= len) {
+				std::memcpy(op, ref, len);
+			}
+			else {
+				// overlapping match repeats the last offset bytes
+				for (std::size_t i {0}; i < len; ++i) {
+					op[i] = ref[i];
+				}
+			}
+			op += len;
+		}
+		return op == oend;
+	}
+private:
+	static constexpr const int hash_log {12};
+	static uint32_t read32(const byte* p) {
+		uint32_t v;
+		std::memcpy(&v, p, sizeof v);
+		return v;
+	}
+	// lengths of 15 and more continue in bytes of 255 until a smaller one
+	static byte* put_len(byte* op, std::size_t len) {
+		for (; len >= 255; len -= 255) {
+			*op++ = 255;
+		}
+		*op++ = static_cast<byte>(len);
+		return op;
+	}
+	static bool get_len(const byte*& ip, const byte* iend, std::size_t& len) {
+		byte b {};
+		do {
+			if (ip == iend) {
+				return false;
+			}
+			b = *ip++;
+			len += b;
+		} while (b == 255);
+		return true;
+	}
+	// a token with both lengths, literals, offset and the rest of the match
+	// length. the last sequence has literals only.
+	static byte* emit(byte* op, const byte* lit, std::size_t lit_n, std::size_t offset, std::size_t match_n) {
+		byte* token = op++;
+		*token = static_cast<byte>(std::min<std::size_t>(lit_n, 15) << 4);
+		if (lit_n >= 15) {
+			op = put_len(op, lit_n - 15);
+		}
+		std::memcpy(op, lit, lit_n);
+		op += lit_n;
+		if (match_n == 0) {
+			return op;
+		}
+		*op++ = static_cast<byte>(offset);
+		*op++ = static_cast<byte>(offset >> 8);
+		*token |= static_cast<byte>(std::min<std::size_t>(match_n - 4, 15));
+		if (match_n - 4 >= 15) {
+			op = put_len(op, match_n - 4 - 15);
+		}
+		return op;
+	}
+};
+/**
+ * address of a UDP peer, stored inline so recording the sender of every
+ * received datagram does not allocate
+ */
+struct endpoint {
+	union {
+		sockaddr sa;
+		sockaddr_in v4;
+		sockaddr_in6 v6;
+	} addr;
+	socklen_t len;
+
+	unsigned short port() const {
+		return ntohs(addr.sa.sa_family == AF_INET6 ? addr.v6.sin6_port : addr.v4.sin_port);
+	}
+	std::string host() const {
+		char s[INET6_ADDRSTRLEN] = {0};
+		if (addr.sa.sa_family == AF_INET6) {
+			inet_ntop(AF_INET6, &addr.v6.sin6_addr, s, sizeof s);
+		}
+		else {
+			inet_ntop(AF_INET, &addr.v4.sin_addr, s, sizeof s);
+		}
+		return s;
+	}
+};
+/**
+ * connects to whichever of addrs accepts first, Happy Eyeballs style
+ * (RFC 8305). attempts start in order, each one stagger after the previous
+ * or right away once all earlier ones failed. the first to succeed wins,
+ * the others are abandoned.
+ *
+ * @param winner if not null, receives the index of the address connected to
+ *
+ * @return non-blocking, close-on-exec socket connected to that address
+ *
+ * @throws std::runtime_error if no attempt succeeded before deadline
+ * @throws std::system_error with the error of the last failed attempt if
+ * all of them failed
+ */
+inline int race_connect(const std::vector<endpoint>& addrs,
+                        std::chrono::steady_clock::time_point deadline,
+                        std::chrono::milliseconds stagger, std::size_t* winner = nullptr) {
+	std::vector<pollfd> pending;
+	std::vector<std::size_t> index;
+	auto abandon = [&pending]() {
+		for (const pollfd& p : pending) {
+			close(p.fd);
+		}
+	};
+	auto won = [&](std::size_t k) {
+		int fd = pending[k].fd;
+		if (winner) {
+			*winner = index[k];
+		}
+		pending.erase(pending.begin() + k);
+		abandon();
+		return fd;
+	};
+	int last_err {ECONNREFUSED};
+	std::size_t next {0};
+	auto next_start = std::chrono::steady_clock::now();
+	while (true) {
+		auto now = std::chrono::steady_clock::now();
+		if (next < addrs.size() && (pending.empty() || now >= next_start)) {
+			const endpoint& to = addrs[next];
+			int fd = ::socket(to.addr.sa.sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd != -1 && (::connect(fd, &to.addr.sa, to.len) == 0 || errno == EINPROGRESS)) {
+				pending.push_back(pollfd {fd, POLLOUT, 0});
+				index.push_back(next);
+				next_start = now + stagger;
+			}
+			else {
+				last_err = errno;
+				if (fd != -1) {
+					close(fd);
+				}
+			}
+			++next;
+			continue;
+		}
+		if (pending.empty()) {
+			throw std::system_error {last_err, std::system_category(), strerror(last_err)};
+		}
+		if (now >= deadline) {
+			abandon();
+			throw std::runtime_error {"timeout reached"};
+		}
+		auto until = next < addrs.size() ? std::min(deadline, next_start) : deadline;
+		auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(until - now);
+		timespec ts {};
+		ts.tv_sec = static_cast<time_t>(left.count() / 1000000000);
+		ts.tv_nsec = static_cast<long>(left.count() % 1000000000);
+		if (::ppoll(pending.data(), pending.size(), &ts, nullptr) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			int err = errno;
+			abandon();
+			throw std::system_error {err, std::system_category(), strerror(err)};
+		}
+		for (std::size_t k {0}; k < pending.size();) {
+			if (pending[k].revents == 0) {
+				++k;
+				continue;
+			}
+			int err {0};
+			socklen_t len = sizeof err;
+			if (getsockopt(pending[k].fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1) {
+				err = errno;
+			}
+			if (err == 0) {
+				return won(k);
+			}
+			last_err = err;
+			close(pending[k].fd);
+			pending.erase(pending.begin() + k);
+			index.erase(index.begin() + k);
+			// no need to wait for the stagger of a failed attempt
+			next_start = std::chrono::steady_clock::now();
+		}
+	}
+}
 // forward decl
 struct addrinfos {
 	struct addrinfo* infos, *p;
 };
 template <protocol P> class server;
 template <protocol P> class client;
+class event_loop;
+class acceptor_pool;
+class runtime;
+class uring;
+class async_stream;
 template <protocol P>
 class inetstream {
 public:
+	// receives the number of bytes transferred so far
+	typedef std::function<void(std::size_t)> progress_handler;
 	inetstream() = delete;
 	inetstream(const inetstream<P>&) = delete;
 	inetstream(inetstream<P>&& other)
-		: _socket_fd {other._socket_fd}, _owns {other._owns}
+		: _socket_fd {other._socket_fd}, _owns {other._owns}, _eof {other._eof},
+		  _in_message {other._in_message}, _message_end {other._message_end},
+		  _read_size {other._read_size}, _adaptive_read {other._adaptive_read},
+		  _terminate_strings {other._terminate_strings}, _codec {std::move(other._codec)},
+		  _compress_min {other._compress_min}, _compress_buf {std::move(other._compress_buf)},
+		  _checksum {other._checksum}, _checksum_failures {other._checksum_failures}
 	{
 		other._socket_fd = -1;
 		_addrinfos.infos = other._addrinfos.infos;
 		_addrinfos.p = other._addrinfos.p;
 		other._addrinfos.infos = other._addrinfos.p = nullptr;
-		auto pos = other.size() - 1;
+		_pool = std::move(other._pool);
 		_send_buf = std::move(other._send_buf);
 		_recv_buf = std::move(other._recv_buf);
-		_read_pos = _recv_buf.begin() + pos;
+		_read_pos = other._read_pos;
+		other._read_pos = 0;
+		_datagrams = std::move(other._datagrams);
+		_next_datagram = other._next_datagram;
+		_send_marks = std::move(other._send_marks);
+		_segments = std::move(other._segments);
+		_zerocopy = other._zerocopy;
+		_zc_next = other._zc_next;
+		_zc_pending = std::move(other._zc_pending);
+		_peer = other._peer;
 	}
 	~inetstream() {
 		if (_owns) {
@@ -116,14 +1124,12 @@ public:
 	                        !std::is_same<T, double>::value &&
 	                        !std::is_same<T, std::string>::value &&
 	                        !std::is_same<typename std::remove_const<T>::type, char[]>::value &&
-	                        !std::is_same<typename std::remove_const<T>::type, char*>::value,
+	                        !std::is_same<typename std::remove_const<T>::type, char*>::value &&
+	                        !is_elem_container<T>::value &&
+	                        !has_schema<T>::value,
 	                        inetstream<P>&>::type
 	operator<<(T t) {
-		unsigned char chars[sizeof(T)];
-		std::memcpy(&chars[0], &t, sizeof(T));
-		for (std::size_t s {0}; s < sizeof t; ++s) {
-			this->_send_buf.push_back(chars[s]);
-		}
+		this->append(&t, sizeof t);
 		return *this;
 	}
 	/**
@@ -141,7 +1147,9 @@ public:
 	                        !std::is_same<T, double>::value &&
 	                        !std::is_same<T, std::string>::value &&
 	                        !std::is_same<typename std::remove_const<T>::type, char[]>::value &&
-	                        !std::is_same<typename std::remove_const<T>::type, char*>::value, void>::type
+	                        !std::is_same<typename std::remove_const<T>::type, char*>::value &&
+	                        !is_elem_container<T>::value &&
+	                        !has_schema<T>::value, void>::type
 	operator>>(T& t) {
 		if (this->size() < sizeof(T)) {
 			std::stringstream ss;
@@ -149,54 +1157,29 @@ public:
 			   << this->size() << " bytes";
 			throw std::runtime_error {ss.str()};
 		}
-		unsigned char chars[sizeof(T)];
-		for (std::size_t i {0}; i < sizeof(T); ++i) {
-			chars[i] = *(this->_read_pos)++;
-		}
-		std::memcpy(&t, &chars[0], sizeof(T));
+		std::memcpy(&t, _recv_buf.data() + _read_pos, sizeof(T));
+		this->_read_pos += sizeof(T);
 	}
 	inetstream<P>& operator<< (uint16_t us) {
-		constexpr std::size_t sz = sizeof us;
-		// no undefined behaviour, since aliased type is unsigned char
-		union {
-			uint16_t i;
-			byte b[sz];
-		} u {0};
-		u.i = htons(us);
-		for (std::size_t s {0}; s < sz; ++s) {
-			this->_send_buf.push_back(u.b[s]);
-		}
+		uint16_t n = htons(us);
+		this->append(&n, sizeof n);
 		return *this;
 	}
 	inetstream<P>& operator<< (int16_t s) {
 		return this->operator<<(static_cast<uint16_t>(s));
 	}
 	inetstream<P>& operator<< (uint32_t ul) {
-		constexpr std::size_t sz = sizeof ul;
-		union {
-			uint32_t i;
-			byte b[sz];
-		} u {0};
-		u.i = htonl(ul);
-		for (std::size_t s {0}; s < sz; ++s) {
-			this->_send_buf.push_back(u.b[s]);
-		}
+		uint32_t n = htonl(ul);
+		this->append(&n, sizeof n);
 		return *this;
 	}
 	inetstream<P>& operator<< (int32_t l) {
 		return this->operator<<(static_cast<uint32_t>(l));
 	}
 	inetstream<P>& operator<< (uint64_t ull) {
-		constexpr std::size_t sz = sizeof ull;
-		union {
-			uint64_t i;
-			byte b[sz];
-		} u {0};
-		u.i  = static_cast<uint64_t>(htonl((ull & 0xffffffff00000000) >> 32));
-		u.i |= static_cast<uint64_t>(htonl(ull & 0x00000000ffffffff)) << 32;
-		for (std::size_t s {0}; s < sz; ++s) {
-			this->_send_buf.push_back(u.b[s]);
-		}
+		uint64_t n = static_cast<uint64_t>(htonl((ull & 0xffffffff00000000) >> 32));
+		n |= static_cast<uint64_t>(htonl(ull & 0x00000000ffffffff)) << 32;
+		this->append(&n, sizeof n);
 		return *this;
 	}
 	inetstream<P>& operator<< (int64_t ll) {
@@ -216,17 +1199,12 @@ public:
 		*this << ull;
 		return *this;
 	}
-	inetstream<P>& operator<< (std::string s) {
-		for (const char c : s) {
-			this->_send_buf.push_back(c);
-		}
+	inetstream<P>& operator<< (const std::string& s) {
+		this->append(s.data(), s.size() + (_terminate_strings ? 1 : 0));
 		return *this;
 	}
 	inetstream<P>& operator<< (const char* p) {
-		std::size_t sz = std::strlen(p);
-		for (std::size_t i {0}; i < sz; ++i) {
-			this->_send_buf.push_back(p[i]);
-		}
+		this->append(p, std::strlen(p) + (_terminate_strings ? 1 : 0));
 		return *this;
 	}
 	void operator>> (uint16_t& us) {
@@ -242,7 +1220,7 @@ public:
 			byte b[sz];
 		} u {0};
 		for (std::size_t s = 0; s < sz; ++s) {
-			u.b[s] = *this->_read_pos++;
+			u.b[s] = this->_recv_buf[this->_read_pos++];
 		}
 		us = ntohs(u.i);
 	}
@@ -264,7 +1242,7 @@ public:
 			byte b[sz];
 		} u {0};
 		for (std::size_t s = 0; s < sz; ++s) {
-			u.b[s] = *this->_read_pos++;
+			u.b[s] = this->_recv_buf[this->_read_pos++];
 		}
 		ul = ntohl(u.i);
 	}
@@ -308,63 +1286,271 @@ public:
 		*this >> ull;
 		std::memcpy(&d, &ull, sizeof(double));
 	}
-	void operator>> (std::string& s) {
-		s.clear();
-		while (this->size() > 0) {
-			byte b = *(this->_read_pos)++;
-			if (b != 0) {
-				s += b;
-			}
-			else {
-				break;
-			}
-		}
-	}
 	/**
-	 * sends data pushed into the stream over the network to remote
-	 *
+	 * push count elements at p onto the stream in network byte order, the
+	 * same as pushing them one by one but converted as a whole block
 	 */
-	template <protocol T = P>
-	typename std::enable_if<is_tcp_prot<T>::value, void>::type
-	send() {
-		std::chrono::milliseconds timeout {INET_MAX_SEND_TIMEOUT_MS};
-		auto t_end = std::chrono::system_clock::now() + timeout;
-		auto total = _send_buf.size();
-		do {
-			int sent_this_iter = 0;
-			sent_this_iter = ::send(_socket_fd, &_send_buf[_send_buf.size() - total], total, 0);
-			if (sent_this_iter == -1) {
-				throw std::system_error {errno, std::system_category(), strerror(errno)};
-			}
-			if (std::chrono::system_clock::now() > t_end) {
-				throw std::runtime_error {"timeout reached"};
-			}
-			total -= sent_this_iter;
-		} while (total > 0);
-		this->clear();
+	template <typename T>
+	typename std::enable_if<is_array_elem<T>::value, inetstream<P>&>::type
+	write_array(const T* p, std::size_t count) {
+		std::size_t old_sz = _send_buf.size();
+		_send_buf.resize(old_sz + count * sizeof(T));
+		swap_copy<sizeof(T)>(_send_buf.data() + old_sz, reinterpret_cast<const byte*>(p), count);
+		return *this;
 	}
-	/**
-	 * sends data pushed into the stream over the network to remote
+	template <typename T>
+	inetstream<P>& operator<< (varint_value<T> x) {
+		std::size_t old_sz = _send_buf.size();
+		_send_buf.resize(old_sz + max_varint_size);
+		byte* end = varint_encode(_send_buf.data() + old_sz, zigzag(x.v));
+		_send_buf.resize(end - _send_buf.data());
+		return *this;
+	}
+	template <typename T>
+	inetstream<P>& operator<< (varint_ref<T> x) {
+		return this->operator<<(varint_value<T> {x.v});
+	}
+	/**
+	 * @throws std::runtime_error if the stream holds no complete varint or
+	 * its value does not fit into T
+	 */
+	template <typename T>
+	void operator>> (varint_ref<T> x) {
+		this->read_varints(&x.v, 1);
+	}
+	/**
+	 * push count integers at p as varints, see inet::varint()
+	 */
+	template <typename T>
+	typename std::enable_if<is_varint_elem<T>::value, inetstream<P>&>::type
+	write_varints(const T* p, std::size_t count) {
+		std::size_t old_sz = _send_buf.size();
+		_send_buf.resize(old_sz + count * max_varint_size);
+		byte* out = _send_buf.data() + old_sz;
+		for (std::size_t i {0}; i < count; ++i) {
+			out = varint_encode(out, zigzag(p[i]));
+		}
+		_send_buf.resize(out - _send_buf.data());
+		return *this;
+	}
+	/**
+	 * retrieve count varints from the stream into p. on error nothing is
+	 * consumed.
+	 *
+	 * @throws std::runtime_error if the stream holds less than count
+	 * complete varints or a value does not fit into T
+	 */
+	template <typename T>
+	typename std::enable_if<is_varint_elem<T>::value, void>::type
+	read_varints(T* p, std::size_t count) {
+		const byte* first = _recv_buf.data() + _read_pos;
+		const byte* in = first;
+		const byte* end = first + this->size();
+		for (std::size_t i {0}; i < count; ++i) {
+			uint64_t x {0};
+			std::size_t n = varint_decode(in, end, x);
+			if (n == 0) {
+				throw std::runtime_error {"stream holds no complete varint"};
+			}
+			if (!unzigzag(x, p[i])) {
+				throw std::runtime_error {"varint does not fit into variable"};
+			}
+			in += n;
+		}
+		_read_pos += in - first;
+	}
+	/**
+	 * retrieve count elements from the stream into p
+	 *
+	 * @throws std::runtime_error if the stream holds less than count elements
+	 */
+	template <typename T>
+	typename std::enable_if<is_array_elem<T>::value, void>::type
+	read_array(T* p, std::size_t count) {
+		if (this->size() < count * sizeof(T)) {
+			std::stringstream ss;
+			ss << "tried to read " << count * sizeof(T) << " bytes into array but only got "
+			   << this->size() << " bytes";
+			throw std::runtime_error {ss.str()};
+		}
+		swap_copy<sizeof(T)>(reinterpret_cast<byte*>(p),
+		                     _recv_buf.data() + _read_pos, count);
+		this->_read_pos += count * sizeof(T);
+	}
+	/**
+	 * retrieve the next n bytes without copying them
+	 *
+	 * the view points into the receive buffer and stays valid until the
+	 * stream receives again, is cleared or is destroyed. reading on does
+	 * not invalidate it.
+	 *
+	 * @throws std::runtime_error if the stream holds less than n bytes
+	 */
+	view read_view(std::size_t n) {
+		if (this->size() < n) {
+			std::stringstream ss;
+			ss << "tried to read " << n << " bytes into view but only got "
+			   << this->size() << " bytes";
+			throw std::runtime_error {ss.str()};
+		}
+		view v {_recv_buf.data() + _read_pos, n};
+		_read_pos += n;
+		return v;
+	}
+	/**
+	 * retrieve the bytes up to the next delim without copying them, the
+	 * delimiter itself is consumed but not part of v. v is valid as long as
+	 * one returned by read_view().
+	 *
+	 * @return false and leaves the stream untouched if delim has not been
+	 * received yet
+	 */
+	bool read_until(char delim, view& v) {
+		if (this->size() == 0) {
+			return false;
+		}
+		const byte* first = _recv_buf.data() + _read_pos;
+		const void* hit = std::memchr(first, delim, this->size());
+		if (hit == nullptr) {
+			return false;
+		}
+		std::size_t n = static_cast<std::size_t>(static_cast<const byte*>(hit) - first);
+		v = view {first, n};
+		_read_pos += n + 1;
+		return true;
+	}
+	/**
+	 * push a struct described by INET_SCHEMA, sized once and encoded in one
+	 * pass
+	 *
+	 * @throws std::length_error if a string is longer than 4 GiB, leaving the
+	 *         send buffer as it was
+	 */
+	template <typename T>
+	typename std::enable_if<has_schema<T>::value, inetstream<P>&>::type
+	operator<< (const T& t) {
+		typedef typename schema_of<T>::type s;
+		std::size_t old_sz = _send_buf.size();
+		_send_buf.resize(old_sz + s::size_of(t));
+		try {
+			s::encode(_send_buf.data() + old_sz, t);
+		} catch (...) {
+			_send_buf.resize(old_sz);
+			throw;
+		}
+		return *this;
+	}
+	/**
+	 * retrieve a struct described by INET_SCHEMA. the fields are decoded
+	 * into a copy of t that is moved into t on success, so t stays as it
+	 * was if this throws
+	 *
+	 * @throws std::runtime_error if the stream holds less than its encoding
+	 */
+	template <typename T>
+	typename std::enable_if<has_schema<T>::value, void>::type
+	operator>> (T& t) {
+		typedef typename schema_of<T>::type s;
+		if (this->size() < s::size) {
+			std::stringstream ss;
+			ss << "tried to read " << s::size << " bytes into struct but only got "
+			   << this->size() << " bytes";
+			throw std::runtime_error {ss.str()};
+		}
+		const byte* first = _recv_buf.data() + _read_pos;
+		const byte* end = first + this->size();
+		T tmp(t);
+		const byte* last = s::decode(first, end, tmp);
+		if (last > end) {
+			throw std::runtime_error {"struct exceeds the received data"};
+		}
+		t = std::move(tmp);
+		_read_pos += last - first;
+	}
+	/**
+	 * push all elements of a std::vector or std::array, without their count
+	 */
+	template <typename C>
+	typename std::enable_if<is_elem_container<C>::value, inetstream<P>&>::type
+	operator<< (const C& c) {
+		return this->write_array(c.data(), c.size());
+	}
+	/**
+	 * fill all elements of a std::vector or std::array, so vectors have to
+	 * be resized to the expected count beforehand
+	 */
+	template <typename C>
+	typename std::enable_if<is_elem_container<C>::value, void>::type
+	operator>> (C& c) {
+		this->read_array(c.data(), c.size());
+	}
+	/**
+	 * retrieve everything up to the next NUL byte, which is consumed but not
+	 * stored, or up to the end of the data if there is none
+	 */
+	void operator>> (std::string& s) {
+		std::size_t avail = this->size();
+		const char* first = reinterpret_cast<const char*>(_recv_buf.data() + _read_pos);
+		const void* nul = avail > 0 ? std::memchr(first, 0, avail) : nullptr;
+		std::size_t n = nul != nullptr ? static_cast<const char*>(nul) - first : avail;
+		s.assign(first, n);
+		_read_pos += nul != nullptr ? n + 1 : n;
+	}
+	/**
+	 * sends data pushed into the stream over the network to remote
+	 *
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, void>::type
+	send() {
+		// serialized data and buffers queued by write_ref() in one go
+		std::size_t cnt = this->gather(0);
+		this->send_gathered(cnt, this->send_size(), nullptr);
+		this->clear_send();
+	}
+	/**
+	 * sends data pushed into the stream over the network to remote
+	 *
+	 * a stream of a server has no remote of its own, it answers the sender
+	 * of the datagram being read instead, see reply()
 	 *
 	 */
 	template <protocol T = P>
 	typename std::enable_if<is_udp_prot<T>::value, void>::type
 	send() {
-		std::chrono::milliseconds timeout {INET_MAX_SEND_TIMEOUT_MS};
-		auto t_end = std::chrono::system_clock::now() + timeout;
-		auto total = _send_buf.size();
-		do {
-			int sent_this_iter =
-				::sendto(_socket_fd, &_send_buf[_send_buf.size() - total], total, 0,
-				         _addrinfos.p->ai_addr, _addrinfos.p->ai_addrlen);
-			if (sent_this_iter == -1) {
-				throw std::system_error {errno, std::system_category(), strerror(errno)};
-			}
-			if (std::chrono::system_clock::now() > t_end) {
-				throw std::runtime_error {"timeout reached"};
-			}
-			total -= sent_this_iter;
-		} while (total > 0);
+		socklen_t len {0};
+		const sockaddr* to = this->default_destination(len);
+		this->send_datagram(to, len);
+	}
+	/**
+	 * sends data pushed into the stream as one datagram to the given peer,
+	 * e.g. one that peer() returned earlier
+	 *
+	 * unlike send() this discards the pushed data afterwards, so the stream
+	 * is ready for the next datagram right away
+	 *
+	 * @throws std::system_error if ::sendto() encountered an error
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, void>::type
+	send_to(const endpoint& to) {
+		this->send_datagram(&to.addr.sa, to.len);
+		this->clear_send();
+	}
+	/**
+	 * sends data pushed into the stream to the sender of the datagram being
+	 * read, see peer()
+	 *
+	 * @throws std::runtime_error if no datagram has been received yet
+	 * @throws std::system_error if ::sendto() encountered an error
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, void>::type
+	reply() {
+		if (_peer.len == 0) {
+			throw std::runtime_error {"no datagram received to reply to"};
+		}
+		this->send_to(_peer);
 	}
 	/**
 	 * receives network data, populating the stream with data
@@ -375,41 +1561,39 @@ public:
 	template <protocol T = P>
 	typename std::enable_if<is_tcp_prot<T>::value, std::size_t>::type
 	recv(std::size_t sz) {
-		std::chrono::milliseconds timeout {INET_MAX_RECV_TIMEOUT_MS};
-		auto t_end = std::chrono::system_clock::now() + timeout;
-		// cache read_pos pointer, since _recv_buf may realloc
-		auto read_offset_ = _read_pos - _recv_buf.begin(); 
-		auto tmp_size = _recv_buf.size();
-		constexpr const std::size_t SZ {1024};
-		int read {0};
-		std::array<unsigned char, SZ> buf;
-		do {
-			if (sz < SZ) {
-				read = ::recv(_socket_fd, &buf[0], sz, 0);
-			}
-			else {
-				read = ::recv(_socket_fd, &buf[0], SZ - 1, 0);
-			}
-			if (read == -1) {
-				if (errno == EAGAIN || errno == EWOULDBLOCK) {
-					if (std::chrono::system_clock::now() < t_end) {
-						// wait until timeout is reached
-						continue;
-					}
-					break;
-				}
-				throw std::system_error {errno, std::system_category(), strerror(errno)};
-			}
+		return this->recv(sz, std::chrono::milliseconds {INET_MAX_RECV_TIMEOUT_MS});
+	}
+	/**
+	 * receives network data, populating the stream with data
+	 *
+	 * a timeout of zero only takes what is already available, up to sz
+	 * bytes, which is what handlers driven by an event_loop want
+	 *
+	 * @param s number of bytes to try and receive
+	 * @param timeout duration after which to give up waiting for data
+	 * @return the number of bytes received
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, std::size_t>::type
+	recv(std::size_t sz, std::chrono::milliseconds timeout) {
+		if (sz == 0) {
+			return 0;
+		}
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		std::size_t total {0};
+		while (total < sz) {
+			std::size_t read = this->recv_some(std::min(sz - total, _read_size), t_end);
 			if (read == 0) {
+				// timeout or orderly shutdown by remote
 				break;
 			}
-			if (read > 0) {
-				sz -= read;
+			total += read;
+			// a peer trickling data must not keep us past the deadline
+			if (timeout.count() > 0 && std::chrono::steady_clock::now() >= t_end) {
+				break;
 			}
-			_recv_buf.insert(_recv_buf.end(), buf.begin(), buf.begin() + read);
-		} while (sz && std::chrono::system_clock::now() < t_end);
-		_read_pos = _recv_buf.begin() + read_offset_;
-		return _recv_buf.size() - tmp_size;
+		}
+		return total;
 	}
 	/**
 	 * receives data from network and stores it in stream
@@ -424,394 +1608,2681 @@ public:
 	typename std::enable_if<is_udp_prot<T>::value, std::size_t>::type
 	recv() {
 		std::chrono::milliseconds timeout {INET_MAX_RECV_TIMEOUT_MS};
-		// cache offset because recv may cause _recv_buf to realloc
-		auto read_offset_ = _read_pos - _recv_buf.begin(); 
-		struct sockaddr_storage remote_addr;
-		socklen_t addr_len = sizeof(remote_addr);
-		constexpr const std::size_t SZ {1024};
-		std::array<unsigned char, SZ> buf;
+		this->compact();
+		endpoint from {};
+		socklen_t addr_len {0};
+		std::size_t old_sz = _recv_buf.size();
 		int num_recv {0};
 		if (this->select(timeout)) {
-			num_recv = ::recvfrom(_socket_fd, &buf[0], SZ - 1, 0,
-			                      reinterpret_cast<struct sockaddr*>(&remote_addr), &addr_len);
+			addr_len = sizeof from.addr;
+			_recv_buf.resize(old_sz + _read_size);
+			num_recv = ::recvfrom(_socket_fd, _recv_buf.data() + old_sz, _read_size, 0,
+			                      &from.addr.sa, &addr_len);
+			_recv_buf.resize(old_sz + (num_recv > 0 ? num_recv : 0));
 		}
 		if (num_recv == -1) {
 			throw std::system_error {errno, std::system_category(), strerror(errno)};
 		}
-		if (num_recv == 0)
-			return 0;
-		_recv_buf.insert(_recv_buf.end(), buf.begin(), buf.begin() + num_recv);
-		_read_pos = _recv_buf.begin() + read_offset_;
+		if (addr_len > 0 && _checksum) {
+			std::size_t sz = this->strip_checksum(old_sz, num_recv);
+			if (sz == static_cast<std::size_t>(-1)) {
+				_recv_buf.resize(old_sz);
+				return 0;
+			}
+			num_recv = static_cast<int>(sz);
+			_recv_buf.resize(old_sz + sz);
+		}
+		if (addr_len > 0) {
+			from.len = addr_len;
+			_peer = from;
+			_datagrams.push_back(datagram {old_sz, static_cast<std::size_t>(num_recv), from});
+		}
 		return num_recv;
 	}
-	bool empty() const { return size() == 0; }
-	void clear() { _send_buf.clear(); _recv_buf.clear(); _read_pos = _recv_buf.begin(); }
-	std::size_t size() const { return _recv_buf.end() - _read_pos; }
 	/**
-	 * blocks while now() < time_of_call + timeout and checks if data can be
-	 * recv()-ed
+	 * receives up to n datagrams with a single ::recvmmsg(), waiting at most
+	 * timeout for the first one. every datagram gets read_size() bytes of
+	 * room, anything beyond that is cut off, but never more than the largest
+	 * possible datagram. no more datagrams are taken than fit into
+	 * INET_MAX_BATCH_SIZE bytes, so a small read_size() allows larger
+	 * batches. use next_datagram() to read them one by one.
 	 *
-	 * @param timeout duration for which to wait for data to arrive
-	 *
-	 * @return early true if data can be recv()-ed or false after timeout
-	 * expired otherwise
+	 * @throws std::system_error if ::recvmmsg() encountered an error
 	 *
-	 * @throws std::system_error if ::select() encounters an error
+	 * @return number of datagrams received, without those dropped because
+	 * of a checksum mismatch
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, std::size_t>::type
+	recv_batch(std::size_t n, std::chrono::milliseconds timeout) {
+		if (n == 0 || !this->select(timeout)) {
+			return 0;
+		}
+		this->compact();
+		std::size_t slot = std::min<std::size_t>(_read_size, max_datagram_size);
+		n = std::min<std::size_t>({n, IOV_MAX, std::max<std::size_t>(INET_MAX_BATCH_SIZE / slot, 1)});
+		std::size_t old_sz = _recv_buf.size(), first = _datagrams.size();
+		_recv_buf.resize(old_sz + n * slot);
+		_datagrams.resize(first + n);
+		_mmsgs.resize(n);
+		_iovs.resize(n);
+		for (std::size_t i {0}; i < n; ++i) {
+			_iovs[i].iov_base = _recv_buf.data() + old_sz + i * slot;
+			_iovs[i].iov_len = slot;
+			_mmsgs[i].msg_hdr = msghdr {};
+			_mmsgs[i].msg_hdr.msg_name = &_datagrams[first + i].from.addr;
+			_mmsgs[i].msg_hdr.msg_namelen = sizeof _datagrams[first + i].from.addr;
+			_mmsgs[i].msg_hdr.msg_iov = &_iovs[i];
+			_mmsgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		int got = ::recvmmsg(_socket_fd, _mmsgs.data(), static_cast<unsigned int>(n), MSG_DONTWAIT, nullptr);
+		int err = errno;
+		// pack the datagrams behind each other, so the stream stays contiguous
+		std::size_t end = old_sz, kept = first;
+		for (int i {0}; i < got; ++i) {
+			std::size_t size = _mmsgs[i].msg_len;
+			if (_checksum) {
+				size = this->strip_checksum(old_sz + i * slot, size);
+				if (size == static_cast<std::size_t>(-1)) {
+					continue;
+				}
+			}
+			datagram& d = _datagrams[kept++];
+			if (kept - 1 != first + i) {
+				d.from = _datagrams[first + i].from;
+			}
+			d.offset = end;
+			d.size = size;
+			d.from.len = _mmsgs[i].msg_hdr.msg_namelen;
+			if (end != old_sz + i * slot) {
+				std::memmove(_recv_buf.data() + end, _recv_buf.data() + old_sz + i * slot, d.size);
+			}
+			end += d.size;
+		}
+		_recv_buf.resize(end);
+		_datagrams.resize(kept);
+		if (got == -1) {
+			if (err == EAGAIN || err == EWOULDBLOCK) {
+				return 0;
+			}
+			throw std::system_error {err, std::system_category(), strerror(err)};
+		}
+		return kept - first;
+	}
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, std::size_t>::type
+	recv_batch(std::size_t n) {
+		return this->recv_batch(n, std::chrono::milliseconds {INET_MAX_RECV_TIMEOUT_MS});
+	}
+	/**
+	 * limits reading to the next received datagram, the way recv_message()
+	 * does for TCP. unread bytes of the current datagram are skipped.
 	 *
+	 * @return false if all received datagrams have been handed out
 	 */
-	bool select(std::chrono::milliseconds timeout) const {
-		struct timeval t {};
-		t.tv_sec = timeout.count() / 1000;
-		t.tv_usec = (timeout.count() - t.tv_sec * 1000) * 1000;
-		fd_set rfds {};
-		FD_ZERO(&rfds);
-		FD_SET(_socket_fd, &rfds);
-		int rv = ::select(_socket_fd + 1, &rfds, nullptr, nullptr, &t);
-		if (rv < 0) {
-			// error occured
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, bool>::type
+	next_datagram() {
+		if (_in_message) {
+			_read_pos = _message_end;
+			_in_message = false;
+		}
+		while (_next_datagram < _datagrams.size() && _datagrams[_next_datagram].offset < _read_pos) {
+			++_next_datagram;
+		}
+		if (_next_datagram == _datagrams.size()) {
+			return false;
 		}
-		// 0 on timeout, 1 if socket is ready to recv
-		return static_cast<bool>(rv);
+		const datagram& d = _datagrams[_next_datagram++];
+		_read_pos = d.offset;
+		_message_end = d.offset + d.size;
+		_in_message = true;
+		_peer = d.from;
+		return true;
 	}
-private:
-	inetstream(int socket_fd, addrinfos addrinfos, bool owns)
-		: _socket_fd {socket_fd}, _addrinfos {addrinfos}, _read_pos {_recv_buf.begin()}, _owns {owns}
-	{
+	/**
+	 * @return sender of the datagram selected by next_datagram(), or of the
+	 * one received last by recv(). for TCP the client of a stream returned
+	 * by server::accept(), the address is only formatted by endpoint::host().
+	 */
+	const endpoint& peer() const {
+		return _peer;
 	}
-	friend class server<P>;
-	friend class client<P>;
-	int _socket_fd;
-	addrinfos _addrinfos;
-	std::vector<byte> _send_buf;
-	std::vector<byte> _recv_buf;
-	std::vector<byte>::iterator _read_pos;
-	bool _owns;
-};
-
-template <protocol P>
-class server {
-public:
-	template <protocol T = P, typename std::enable_if<is_tcp_prot<T>::value, int>::type* = nullptr>
-	server(unsigned short Port) : _port {Port}, _addrinfos {nullptr, nullptr} {
-		if (INET_USE_DEFAULT_SIGUSR1_HANDLER) {
-			struct sigaction sa;
-			sa.sa_handler = sigusr1_handler;
-			sigemptyset(&sa.sa_mask);
-			sa.sa_flags = 0;
-			if (sigaction(SIGUSR1, &sa, NULL) != 0) {
-				throw std::system_error {errno, std::system_category(), strerror(errno)};
+	/**
+	 * ends the datagram being pushed onto the stream, so send_batch() sends
+	 * everything pushed since the previous call as one datagram
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, void>::type
+	queue_datagram() {
+		_send_marks.push_back(send_mark {_send_buf.size(), endpoint {}});
+	}
+	/**
+	 * same as queue_datagram() but send_batch() sends this datagram to the
+	 * given peer, so replies to a whole batch of requests can go out at once
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, void>::type
+	queue_datagram(const endpoint& to) {
+		_send_marks.push_back(send_mark {_send_buf.size(), to});
+	}
+	/**
+	 * sends all queued datagrams with as few ::sendmmsg() calls as possible.
+	 * data pushed after the last queue_datagram() goes out as a datagram of
+	 * its own.
+	 *
+	 * @throws std::runtime_error if INET_MAX_SEND_TIMEOUT_MS is exceeded
+	 * @throws std::system_error if ::sendmmsg() encountered an error
+	 *
+	 * @return number of datagrams sent
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, std::size_t>::type
+	send_batch() {
+		if (_send_marks.empty() ? !_send_buf.empty() : _send_marks.back().end != _send_buf.size()) {
+			this->queue_datagram();
+		}
+		std::size_t n = _send_marks.size(), per = _checksum ? 2 : 1;
+		_mmsgs.resize(n);
+		_iovs.resize(n * per);
+		std::vector<uint32_t> crcs(_checksum ? n : 0);
+		std::size_t start {0};
+		for (std::size_t i {0}; i < n; ++i) {
+			send_mark& m = _send_marks[i];
+			iovec* iov = &_iovs[i * per];
+			iov[0].iov_base = _send_buf.data() + start;
+			iov[0].iov_len = m.end - start;
+			if (_checksum) {
+				crcs[i] = htonl(crc32c(iov[0].iov_base, iov[0].iov_len));
+				iov[1].iov_base = &crcs[i];
+				iov[1].iov_len = sizeof crcs[i];
 			}
+			start = m.end;
+			_mmsgs[i].msg_hdr = msghdr {};
+			if (m.to.len > 0) {
+				_mmsgs[i].msg_hdr.msg_name = &m.to.addr;
+				_mmsgs[i].msg_hdr.msg_namelen = m.to.len;
+			}
+			else {
+				socklen_t len {0};
+				_mmsgs[i].msg_hdr.msg_name = const_cast<sockaddr*>(this->default_destination(len));
+				_mmsgs[i].msg_hdr.msg_namelen = len;
+			}
+			_mmsgs[i].msg_hdr.msg_iov = iov;
+			_mmsgs[i].msg_hdr.msg_iovlen = per;
 		}
-		addrinfo hints;
-		std::memset(&hints, 0, sizeof hints);
-		if (INET_IPV == 4) {
-			hints.ai_family = AF_INET;
+		std::chrono::milliseconds timeout {INET_MAX_SEND_TIMEOUT_MS};
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		std::size_t sent {0};
+		while (sent < n) {
+			int rv = ::sendmmsg(_socket_fd, _mmsgs.data() + sent,
+			                    static_cast<unsigned int>(std::min<std::size_t>(n - sent, IOV_MAX)), 0);
+			if (rv == -1) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					throw std::system_error {errno, std::system_category(), strerror(errno)};
+				}
+				if (!wait_ready(_socket_fd, POLLOUT, t_end)) {
+					throw std::runtime_error {"timeout reached"};
+				}
+				continue;
+			}
+			sent += rv;
+			if (sent < n && std::chrono::steady_clock::now() > t_end) {
+				throw std::runtime_error {"timeout reached"};
+			}
 		}
-		else if (INET_IPV == 6) {
-			hints.ai_family = AF_INET6;
+		this->clear_send();
+		return n;
+	}
+	/**
+	 * sends data pushed into the stream as one message, prefixed with its
+	 * length as 32 bit unsigned integer in network byte order. header and
+	 * payload go out in a single write.
+	 *
+	 * unlike send() this leaves received data untouched, so messages
+	 * already pulled in by recv_message() are not lost. with set_checksum()
+	 * a CRC32C of the payload follows the header.
+	 *
+	 * @throws std::runtime_error if the message exceeds INET_MAX_MESSAGE_SIZE
+	 * or sending timed out
+	 * @throws std::system_error if ::sendmsg() encountered an error
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, void>::type
+	send_message() {
+		std::size_t sz = this->send_size();
+		if (sz > INET_MAX_MESSAGE_SIZE) {
+			throw std::runtime_error {"message too large"};
 		}
-		else {
-			hints.ai_family = AF_UNSPEC;
+		if (_codec && sz >= _compress_min && this->send_compressed(sz)) {
+			return;
 		}
-		hints.ai_socktype = SOCK_STREAM;
-		hints.ai_flags = AI_PASSIVE;
-		char port[6] = {0};
-		std::stringstream ss;
-		ss << _port;
-		ss >> port;
-		port[5] = 0;
-		int rv = getaddrinfo(NULL, port, &hints, &_addrinfos.infos);
-		if (rv != 0) {
-			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		// length header, followed by the checksum if there is one
+		uint32_t frame[2];
+		std::size_t frame_sz = _checksum ? sizeof frame : sizeof frame[0];
+		std::shared_ptr<uint32_t> kept_frame;
+		uint32_t* f = frame;
+		if (this->use_zerocopy(frame_sz + sz)) {
+			// the kernel reads the frame after this returns
+			kept_frame.reset(new uint32_t[2], std::default_delete<uint32_t[]>());
+			f = kept_frame.get();
+		}
+		std::size_t cnt = this->gather(1);
+		f[0] = htonl(static_cast<uint32_t>(frame_sz - sizeof frame[0] + sz) |
+		             (_checksum ? message_checksummed : 0));
+		if (_checksum) {
+			uint32_t crc {0};
+			for (std::size_t i {1}; i < cnt; ++i) {
+				crc = crc32c(_iovs[i].iov_base, _iovs[i].iov_len, crc);
+			}
+			f[1] = htonl(crc);
+		}
+		_iovs[0].iov_base = f;
+		_iovs[0].iov_len = frame_sz;
+		this->send_gathered(cnt, frame_sz + sz, std::move(kept_frame));
+		this->clear_send();
+	}
+	/**
+	 * receives one complete message sent by send_message()
+	 *
+	 * every read pulls in as much as is available, so messages that arrived
+	 * together are served from the stream without further syscalls. until
+	 * the next call to recv_message() or clear(), size() and all operator>>
+	 * are limited to the payload of this message. unread payload is skipped
+	 * by the next call.
+	 *
+	 * @param timeout duration for which to wait for the message to arrive
+	 *
+	 * @return true if a message was received, false on timeout or if remote
+	 * closed the connection
+	 *
+	 * @throws std::runtime_error if the length header announces more than
+	 * INET_MAX_MESSAGE_SIZE bytes of payload or the message does not match
+	 * its checksum.
+	 * the message is skipped by the next call in that case.
+	 * @throws std::system_error if ::recv() encountered an error
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, bool>::type
+	recv_message(std::chrono::milliseconds timeout) {
+		if (_in_message) {
+			_read_pos = _message_end;
+			_in_message = false;
+		}
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		while (true) {
+			std::size_t avail = _recv_buf.size() - _read_pos;
+			std::size_t need = sizeof(uint32_t) - std::min(avail, sizeof(uint32_t));
+			if (need == 0) {
+				uint32_t header {};
+				std::memcpy(&header, _recv_buf.data() + _read_pos, sizeof header);
+				header = ntohl(header);
+				std::size_t len = header & message_length_mask;
+				// the limit is on the payload, a checksum comes on top
+				if (len > INET_MAX_MESSAGE_SIZE + (header & message_checksummed ? sizeof(uint32_t) : 0)) {
+					throw std::runtime_error {"message too large"};
+				}
+				if (avail >= sizeof header + len) {
+					_read_pos += sizeof header;
+					_message_end = _read_pos + len;
+					_in_message = true;
+					if (header & message_checksummed) {
+						this->verify_checksum(len);
+						len -= sizeof(uint32_t);
+					}
+					if (header & message_compressed) {
+						this->inflate(len);
+					}
+					return true;
+				}
+				need = sizeof header + len - avail;
+			}
+			if (this->recv_some(std::max(need, _read_size), t_end) == 0) {
+				return false;
+			}
+		}
+	}
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, bool>::type
+	recv_message() {
+		return this->recv_message(std::chrono::milliseconds {INET_MAX_RECV_TIMEOUT_MS});
+	}
+	/**
+	 * queue sz bytes at p to be sent in place, after everything pushed so
+	 * far and before everything pushed later, without copying them into the
+	 * stream. the bytes go out as they are, without byte order conversion.
+	 *
+	 * owner is released once the bytes are sent or discarded by clear(),
+	 * it has to keep them unchanged until then
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, inetstream<P>&>::type
+	write_ref(const void* p, std::size_t sz, std::shared_ptr<const void> owner) {
+		_segments.push_back(segment {_send_buf.size(), static_cast<const byte*>(p), sz, std::move(owner)});
+		return *this;
+	}
+	/**
+	 * same as above, but release is called once the bytes are sent or
+	 * discarded
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, inetstream<P>&>::type
+	write_ref(const void* p, std::size_t sz, std::function<void()> release) {
+		return this->write_ref(p, sz, std::shared_ptr<const void> {p, [release](const void*) {
+			if (release) {
+				release();
+			}
+		}});
+	}
+	/**
+	 * queue the contents of a shared container, e.g. a std::vector or
+	 * std::string, to be sent in place
+	 */
+	template <typename C, protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, inetstream<P>&>::type
+	write_ref(std::shared_ptr<C> c) {
+		const void* p = c->data();
+		std::size_t sz = c->size() * sizeof(*c->data());
+		return this->write_ref(p, sz, std::shared_ptr<const void> {std::move(c)});
+	}
+	/**
+	 * sends len bytes of the file fd starting at offset with ::sendfile(),
+	 * without reading them into memory. data pushed onto the stream before
+	 * is sent first. the file position of fd is left unchanged.
+	 *
+	 * INET_MAX_SEND_TIMEOUT_MS applies to every step instead of the whole
+	 * transfer, so large files only time out if remote stops reading
+	 *
+	 * @param on_progress called with the number of file bytes sent so far
+	 *
+	 * @throws std::runtime_error if a step timed out
+	 * @throws std::system_error if ::sendfile() encountered an error
+	 *
+	 * @return number of bytes sent, less than len if the file ended first
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, std::size_t>::type
+	send_file(int fd, off_t offset, std::size_t len, progress_handler on_progress = nullptr) {
+		if (this->send_size() > 0) {
+			this->send();
+		}
+		std::chrono::milliseconds timeout {INET_MAX_SEND_TIMEOUT_MS};
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		std::size_t total {0};
+		while (total < len) {
+			ssize_t sent = ::sendfile(_socket_fd, fd, &offset,
+			                          std::min<std::size_t>(len - total, INET_FILE_CHUNK_SIZE));
+			if (sent == -1) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					throw std::system_error {errno, std::system_category(), strerror(errno)};
+				}
+				if (!wait_ready(_socket_fd, POLLOUT, t_end)) {
+					throw std::runtime_error {"timeout reached"};
+				}
+				continue;
+			}
+			if (sent == 0) {
+				break;
+			}
+			total += static_cast<std::size_t>(sent);
+			t_end = std::chrono::steady_clock::now() + timeout;
+			if (on_progress) {
+				on_progress(total);
+			}
+		}
+		return total;
+	}
+	/**
+	 * receives len bytes and writes them to the file fd at its current
+	 * position. received data not read yet is written first, the rest moves
+	 * from the socket to the file with ::splice() through a pipe, without
+	 * passing through user space.
+	 *
+	 * INET_MAX_RECV_TIMEOUT_MS applies to every step instead of the whole
+	 * transfer
+	 *
+	 * @param on_progress called with the number of bytes written so far
+	 *
+	 * @throws std::system_error if creating the pipe, ::splice() or
+	 * ::write() encountered an error, with ENOSPC if the file takes no more
+	 * bytes
+	 *
+	 * @return number of bytes written, less than len on timeout or if remote
+	 * closed the connection
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, std::size_t>::type
+	recv_to_file(int fd, std::size_t len, progress_handler on_progress = nullptr) {
+		std::size_t total {0};
+		while (total < len && this->size() > 0) {
+			ssize_t written = ::write(fd, _recv_buf.data() + _read_pos,
+			                          std::min(len - total, this->size()));
+			if (written == -1) {
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			// nothing written to a file means there is no room left for it
+			if (written == 0) {
+				throw std::system_error {ENOSPC, std::system_category(), strerror(ENOSPC)};
+			}
+			_read_pos += static_cast<std::size_t>(written);
+			total += static_cast<std::size_t>(written);
+		}
+		if (total > 0 && on_progress) {
+			on_progress(total);
+		}
+		if (total == len) {
+			return total;
+		}
+		struct pipe_fds {
+			int fd[2] {-1, -1};
+			~pipe_fds() {
+				if (fd[0] != -1) {
+					close(fd[0]);
+					close(fd[1]);
+				}
+			}
+		} p;
+		if (::pipe2(p.fd, O_CLOEXEC) == -1) {
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		// a larger pipe needs fewer steps, the default holds only 64 KB
+		int pipe_sz = ::fcntl(p.fd[1], F_SETPIPE_SZ, INET_FILE_CHUNK_SIZE);
+		std::size_t chunk = pipe_sz > 0 ? static_cast<std::size_t>(pipe_sz) : 64 * 1024;
+		std::chrono::milliseconds timeout {INET_MAX_RECV_TIMEOUT_MS};
+		while (total < len) {
+			if (!wait_ready(_socket_fd, POLLIN, std::chrono::steady_clock::now() + timeout)) {
+				break;
+			}
+			ssize_t in = ::splice(_socket_fd, nullptr, p.fd[1], nullptr,
+			                      std::min(len - total, chunk), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (in == -1) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					continue;
+				}
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			if (in == 0) {
+				_eof = true;
+				break;
+			}
+			for (ssize_t left = in; left > 0;) {
+				ssize_t out = ::splice(p.fd[0], nullptr, fd, nullptr, static_cast<std::size_t>(left),
+				                       SPLICE_F_MOVE);
+				if (out == -1) {
+					throw std::system_error {errno, std::system_category(), strerror(errno)};
+				}
+				if (out == 0) {
+					throw std::system_error {ENOSPC, std::system_category(), strerror(ENOSPC)};
+				}
+				left -= out;
+			}
+			total += static_cast<std::size_t>(in);
+			if (on_progress) {
+				on_progress(total);
+			}
+		}
+		return total;
+	}
+	/**
+	 * in zero-copy mode sends of at least INET_ZEROCOPY_MIN_SIZE bytes use
+	 * MSG_ZEROCOPY. the kernel then reads the data while it is transmitted,
+	 * so the stream keeps the send buffer and the owners of buffers queued by
+	 * write_ref() alive until the kernel reports that it is done with them.
+	 * every send reaps these reports, flush_zerocopy() waits for all of them.
+	 * destroying the stream releases the buffers regardless.
+	 *
+	 * @throws std::system_error if the kernel does not support SO_ZEROCOPY
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, void>::type
+	set_zerocopy(bool zerocopy) {
+		int on = zerocopy ? 1 : 0;
+		if (::setsockopt(_socket_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof on) == -1) {
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		_zerocopy = zerocopy;
+	}
+	/**
+	 * @return number of zero-copy sends the kernel has not reported done yet
+	 */
+	std::size_t zerocopy_pending() const { return _zc_pending.size(); }
+	/**
+	 * releases the buffers of all zero-copy sends the kernel reported done,
+	 * without blocking
+	 *
+	 * @throws std::system_error if reading the socket error queue failed
+	 *
+	 * @return number of sends released
+	 */
+	std::size_t reap_zerocopy() {
+		std::size_t released {0};
+		while (!_zc_pending.empty()) {
+			char control[128];
+			msghdr msg {};
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof control;
+			if (::recvmsg(_socket_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					break;
+				}
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+				if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+				    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+					continue;
+				}
+				sock_extended_err err;
+				std::memcpy(&err, CMSG_DATA(cm), sizeof err);
+				if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+					continue;
+				}
+				// send calls ee_info up to ee_data are done, tcp completes in order
+				while (!_zc_pending.empty() &&
+				       static_cast<int32_t>(_zc_pending.front().last - err.ee_data) <= 0) {
+					_zc_pending.pop_front();
+					++released;
+				}
+			}
+		}
+		return released;
+	}
+	/**
+	 * blocks until the kernel reported all zero-copy sends done
+	 *
+	 * @return false if timeout expired first
+	 */
+	bool flush_zerocopy(std::chrono::milliseconds timeout) {
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		while (this->reap_zerocopy(), !_zc_pending.empty()) {
+			// reports in the error queue show up as POLLERR
+			if (!wait_ready(_socket_fd, 0, t_end)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	/**
+	 * take the memory of the send and receive buffers from pool, or from the
+	 * heap if pool is null. streams accepted by a server use its pool.
+	 * buffered data is kept.
+	 */
+	void set_buffer_pool(std::shared_ptr<buffer_pool> pool) {
+		pool_allocator<byte> alloc {pool};
+		buffer send_buf(_send_buf.begin(), _send_buf.end(), alloc);
+		buffer recv_buf(_recv_buf.begin(), _recv_buf.end(), alloc);
+		_send_buf = std::move(send_buf);
+		_recv_buf = std::move(recv_buf);
+		_compress_buf = buffer {alloc};
+		_pool = std::move(pool);
+	}
+	/**
+	 * hint how many bytes are going to be pushed onto the stream, so the
+	 * send buffer does not need to grow while serializing
+	 *
+	 * @param sz number of bytes the send buffer should be able to hold
+	 */
+	void reserve(std::size_t sz) { _send_buf.reserve(sz); }
+	/**
+	 * set how many bytes a single read into the stream may take. larger
+	 * sizes need fewer syscalls for bulk data but reserve more memory.
+	 */
+	void set_read_size(std::size_t sz) { _read_size = std::max<std::size_t>(sz, 1); }
+	std::size_t read_size() const { return _read_size; }
+	/**
+	 * compress messages sent by send_message() with c once they reach
+	 * min_size bytes, unless that does not make them smaller. c = nullptr
+	 * turns compression off.
+	 *
+	 * receivers pick the codec by the id every compressed message carries.
+	 * they know the built-in lz_codec and the codec set on them, so a stream
+	 * sending with lz_codec works with any peer.
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, void>::type
+	set_codec(std::shared_ptr<const codec> c, std::size_t min_size = INET_COMPRESS_MIN_SIZE) {
+		_codec = std::move(c);
+		_compress_min = min_size;
+	}
+	/**
+	 * if set, send_message() adds a CRC32C of the payload to every message,
+	 * which recv_message() verifies before anything can be read. receivers
+	 * check any message that carries one, whether they set this or not.
+	 *
+	 * for UDP every datagram gets the checksum appended. both ends have to
+	 * set this, datagrams that do not match are dropped on receive and
+	 * counted by checksum_failures().
+	 */
+	void set_checksum(bool checksum) { _checksum = checksum; }
+	/**
+	 * @return number of datagrams dropped because of a checksum mismatch
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, std::size_t>::type
+	checksum_failures() const {
+		return _checksum_failures;
+	}
+	/**
+	 * if set, operator<< writes strings including their NUL terminator, so
+	 * operator>> reads them back one by one
+	 */
+	void set_terminate_strings(bool terminate) { _terminate_strings = terminate; }
+	/**
+	 * in adaptive mode the read size doubles, up to INET_MAX_READ_SIZE,
+	 * whenever a read fills it completely
+	 */
+	void set_adaptive_read(bool adaptive) { _adaptive_read = adaptive; }
+	bool empty() const { return size() == 0; }
+	/**
+	 * @return true once recv() noticed that remote closed the connection
+	 */
+	bool eof() const { return _eof; }
+	/**
+	 * discards received data and data pushed onto the stream
+	 */
+	void clear() {
+		this->clear_send();
+		this->clear_recv();
+	}
+	/**
+	 * discards data pushed onto the stream that has not been sent yet
+	 */
+	void clear_send() {
+		_send_buf.clear();
+		_send_marks.clear();
+		_segments.clear();
+	}
+	/**
+	 * discards received data that has not been read yet
+	 */
+	void clear_recv() {
+		_recv_buf.clear();
+		_read_pos = 0;
+		_in_message = false;
+		_datagrams.clear();
+		_next_datagram = 0;
+	}
+	std::size_t size() const {
+		if (_in_message) {
+			return _message_end - _read_pos;
+		}
+		return _recv_buf.size() - _read_pos;
+	}
+	/**
+	 * blocks while now() < time_of_call + timeout and checks if data can be
+	 * recv()-ed
+	 *
+	 * @param timeout duration for which to wait for data to arrive
+	 *
+	 * @return early true if data can be recv()-ed or false after timeout
+	 * expired otherwise
+	 *
+	 * @throws std::system_error if ::ppoll() encounters an error
+	 *
+	 */
+	bool select(std::chrono::milliseconds timeout) const {
+		return wait_ready(_socket_fd, POLLIN, std::chrono::steady_clock::now() + timeout);
+	}
+private:
+	inetstream(int socket_fd, addrinfos addrinfos, bool owns)
+		: _socket_fd {socket_fd}, _addrinfos {addrinfos}, _read_pos {0}, _owns {owns}, _eof {false},
+		  _in_message {false}, _message_end {0},
+		  _read_size {INET_DEFAULT_READ_SIZE}, _adaptive_read {false}, _terminate_strings {false},
+		  _compress_min {INET_COMPRESS_MIN_SIZE}, _checksum {false}, _checksum_failures {0},
+		  _next_datagram {0}, _peer {}, _zerocopy {false}, _zc_next {0}
+	{
+	}
+	/**
+	 * drops already read bytes from the front of the receive buffer, so a
+	 * long-lived connection only keeps what has not been read yet. bytes
+	 * are only moved once at least as many have been read as are left, which
+	 * keeps the cost per received byte constant.
+	 */
+	void compact() {
+		std::size_t left = _recv_buf.size() - _read_pos;
+		if (_read_pos == 0 || _read_pos < left) {
+			return;
+		}
+		std::memmove(_recv_buf.data(), _recv_buf.data() + _read_pos, left);
+		_recv_buf.resize(left);
+		if (_in_message) {
+			_message_end -= _read_pos;
+		}
+		// datagrams that have been started are either read or skipped
+		std::size_t started {0};
+		while (started < _datagrams.size() && _datagrams[started].offset < _read_pos) {
+			++started;
+		}
+		_datagrams.erase(_datagrams.begin(), _datagrams.begin() + started);
+		for (datagram& d : _datagrams) {
+			d.offset -= _read_pos;
+		}
+		_next_datagram -= std::min(_next_datagram, started);
+		_read_pos = 0;
+	}
+	/**
+	 * fills _iovs from index first on with the send buffer, split wherever
+	 * write_ref() queued a buffer in between
+	 *
+	 * @return index behind the last iovec filled
+	 */
+	std::size_t gather(std::size_t first) {
+		_iovs.resize(first + 2 * _segments.size() + 1);
+		std::size_t n {first}, start {0};
+		for (const segment& seg : _segments) {
+			if (seg.at > start) {
+				_iovs[n].iov_base = _send_buf.data() + start;
+				_iovs[n++].iov_len = seg.at - start;
+				start = seg.at;
+			}
+			if (seg.sz > 0) {
+				_iovs[n].iov_base = const_cast<byte*>(seg.p);
+				_iovs[n++].iov_len = seg.sz;
+			}
+		}
+		if (_send_buf.size() > start) {
+			_iovs[n].iov_base = _send_buf.data() + start;
+			_iovs[n++].iov_len = _send_buf.size() - start;
+		}
+		return n;
+	}
+	// largest UDP payload, over IPv6. IPv4 allows 20 bytes less
+	enum : std::size_t { max_datagram_size = 65535 - 8 };
+	// flags in the upper bits of the length header of a message
+	static constexpr const uint32_t message_compressed {0x80000000u};
+	static constexpr const uint32_t message_checksummed {0x40000000u};
+	static constexpr const uint32_t message_length_mask {0x3fffffffu};
+	static_assert(INET_MAX_MESSAGE_SIZE + sizeof(uint32_t) <= message_length_mask, "INET_MAX_MESSAGE_SIZE too large");
+	/**
+	 * sends the pending message compressed as codec id, uncompressed size
+	 * as 32 bit unsigned integer and compressed data
+	 *
+	 * @return false without sending if compression does not pay off
+	 */
+	bool send_compressed(std::size_t sz) {
+		buffer flat;
+		const byte* src = _send_buf.data();
+		if (!_segments.empty()) {
+			flat.resize(sz);
+			std::size_t cnt = this->gather(0);
+			byte* p = flat.data();
+			for (std::size_t i {0}; i < cnt; ++i) {
+				std::memcpy(p, _iovs[i].iov_base, _iovs[i].iov_len);
+				p += _iovs[i].iov_len;
+			}
+			src = flat.data();
+		}
+		constexpr std::size_t prefix {1 + sizeof(uint32_t)};
+		_compress_buf.resize(prefix + _codec->max_compressed_size(sz));
+		_compress_buf[0] = _codec->id();
+		uint32_t n = htonl(static_cast<uint32_t>(sz));
+		std::memcpy(_compress_buf.data() + 1, &n, sizeof n);
+		std::size_t len = prefix + _codec->compress(src, sz, _compress_buf.data() + prefix);
+		if (len >= sz) {
+			return false;
+		}
+		uint32_t frame[2];
+		std::size_t frame_sz = _checksum ? sizeof frame : sizeof frame[0];
+		frame[0] = htonl(static_cast<uint32_t>(frame_sz - sizeof frame[0] + len) | message_compressed |
+		                 (_checksum ? message_checksummed : 0));
+		frame[1] = htonl(crc32c(_compress_buf.data(), len));
+		iovec iov[2];
+		iov[0].iov_base = frame;
+		iov[0].iov_len = frame_sz;
+		iov[1].iov_base = _compress_buf.data();
+		iov[1].iov_len = len;
+		this->send_iov(iov, 2);
+		this->clear_send();
+		return true;
+	}
+	/**
+	 * checks the message of len bytes at _read_pos against the CRC32C in
+	 * its first four bytes and moves _read_pos past it
+	 *
+	 * @throws std::runtime_error if they do not match
+	 */
+	void verify_checksum(std::size_t len) {
+		uint32_t crc {};
+		if (len < sizeof crc) {
+			throw std::runtime_error {"message checksum mismatch"};
+		}
+		std::memcpy(&crc, _recv_buf.data() + _read_pos, sizeof crc);
+		_read_pos += sizeof crc;
+		if (ntohl(crc) != crc32c(_recv_buf.data() + _read_pos, len - sizeof crc)) {
+			throw std::runtime_error {"message checksum mismatch"};
+		}
+	}
+	/**
+	 * replaces the compressed message of len bytes at _read_pos with its
+	 * payload, keeping whatever was received after it
+	 *
+	 * @throws std::runtime_error if the message is corrupt or its codec
+	 * unknown
+	 */
+	void inflate(std::size_t len) {
+		static const lz_codec builtin;
+		constexpr std::size_t prefix {1 + sizeof(uint32_t)};
+		const byte* body = _recv_buf.data() + _read_pos;
+		if (len < prefix) {
+			throw std::runtime_error {"corrupt compressed message"};
+		}
+		uint32_t out_n {};
+		std::memcpy(&out_n, body + 1, sizeof out_n);
+		out_n = ntohl(out_n);
+		if (out_n > INET_MAX_MESSAGE_SIZE) {
+			throw std::runtime_error {"message too large"};
+		}
+		const codec* c = _codec && _codec->id() == body[0] ? _codec.get() :
+		                 builtin.id() == body[0] ? &builtin : nullptr;
+		if (c == nullptr) {
+			throw std::runtime_error {"message compressed with unknown codec"};
+		}
+		std::size_t tail = _recv_buf.size() - _message_end;
+		// the old receive buffer is released, not kept around for the next one
+		buffer out(out_n + tail, _recv_buf.get_allocator());
+		if (!c->decompress(body + prefix, len - prefix, out.data(), out_n)) {
+			throw std::runtime_error {"corrupt compressed message"};
+		}
+		std::memcpy(out.data() + out_n, _recv_buf.data() + _message_end, tail);
+		_recv_buf.swap(out);
+		_read_pos = 0;
+		_message_end = out_n;
+	}
+	/**
+	 * @return bytes pushed onto the stream plus bytes queued by write_ref()
+	 */
+	std::size_t send_size() const {
+		std::size_t sz = _send_buf.size();
+		for (const segment& seg : _segments) {
+			sz += seg.sz;
+		}
+		return sz;
+	}
+	bool use_zerocopy(std::size_t sz) const { return _zerocopy && sz >= INET_ZEROCOPY_MIN_SIZE; }
+	/**
+	 * writes the first cnt of _iovs, with MSG_ZEROCOPY if use_zerocopy().
+	 * buffers a zero-copy send reads from are kept until the kernel reports
+	 * it done, together with kept.
+	 */
+	void send_gathered(std::size_t cnt, std::size_t sz, std::shared_ptr<const void> kept) {
+		if (!this->use_zerocopy(sz)) {
+			this->send_iov(_iovs.data(), cnt);
+			return;
+		}
+		this->reap_zerocopy();
+		uint32_t first = _zc_next;
+		this->send_iov(_iovs.data(), cnt, MSG_ZEROCOPY);
+		if (_zc_next == first) {
+			return;
+		}
+		zc_send pending {_zc_next - 1, {}};
+		pending.owners.reserve(_segments.size() + 2);
+		pending.owners.push_back(std::move(kept));
+		for (segment& seg : _segments) {
+			pending.owners.push_back(std::move(seg.owner));
+		}
+		pending.owners.push_back(std::make_shared<buffer>(std::move(_send_buf)));
+		_send_buf = buffer {pool_allocator<byte> {_pool}};
+		_zc_pending.push_back(std::move(pending));
+	}
+	/**
+	 * writes all iovecs, sleeping while the socket buffer is full
+	 *
+	 * @throws std::runtime_error if INET_MAX_SEND_TIMEOUT_MS is exceeded
+	 * @throws std::system_error if ::sendmsg() encountered an error
+	 */
+	void send_iov(iovec* iov, std::size_t cnt, int flags = 0) {
+		std::chrono::milliseconds timeout {INET_MAX_SEND_TIMEOUT_MS};
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		while (cnt > 0) {
+			msghdr msg {};
+			msg.msg_iov = iov;
+			msg.msg_iovlen = std::min<std::size_t>(cnt, IOV_MAX);
+			ssize_t sent = ::sendmsg(_socket_fd, &msg, flags);
+			if (sent == -1) {
+				if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+					// out of memory for completion reports, copy the rest
+					flags &= ~MSG_ZEROCOPY;
+					continue;
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					throw std::system_error {errno, std::system_category(), strerror(errno)};
+				}
+				if (!wait_ready(_socket_fd, POLLOUT, t_end)) {
+					throw std::runtime_error {"timeout reached"};
+				}
+				continue;
+			}
+			if (flags & MSG_ZEROCOPY) {
+				// the kernel numbers zero-copy send calls per socket
+				++_zc_next;
+			}
+			// skip what went out, the last iovec may be partially sent
+			std::size_t left = static_cast<std::size_t>(sent);
+			while (cnt > 0 && left >= iov->iov_len) {
+				left -= iov->iov_len;
+				++iov;
+				--cnt;
+			}
+			if (cnt > 0) {
+				iov->iov_base = static_cast<byte*>(iov->iov_base) + left;
+				iov->iov_len -= left;
+			}
+			if (cnt > 0 && std::chrono::steady_clock::now() > t_end) {
+				throw std::runtime_error {"timeout reached"};
+			}
+		}
+	}
+	/**
+	 * receives whatever is available, up to max bytes, directly into the
+	 * receive buffer. waits until deadline if nothing is available.
+	 *
+	 * @return number of bytes received, 0 on timeout or if remote hung up
+	 */
+	std::size_t recv_some(std::size_t max, std::chrono::steady_clock::time_point deadline) {
+		this->compact();
+		std::size_t old_sz = _recv_buf.size();
+		_recv_buf.resize(old_sz + max);
+		ssize_t read {0};
+		while (true) {
+			read = ::recv(_socket_fd, _recv_buf.data() + old_sz, max, 0);
+			if (read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+			    std::chrono::steady_clock::now() < deadline &&
+			    wait_ready(_socket_fd, POLLIN, deadline)) {
+				continue;
+			}
+			break;
+		}
+		int err = errno;
+		_recv_buf.resize(old_sz + (read > 0 ? read : 0));
+		if (_adaptive_read && static_cast<std::size_t>(read) == _read_size &&
+		    _read_size < INET_MAX_READ_SIZE) {
+			// reads keep filling up, try to take more per syscall
+			_read_size = std::min<std::size_t>(_read_size * 2, INET_MAX_READ_SIZE);
+		}
+		if (read == -1) {
+			if (err == EAGAIN || err == EWOULDBLOCK) {
+				return 0;
+			}
+			throw std::system_error {err, std::system_category(), strerror(err)};
+		}
+		if (read == 0) {
+			_eof = true;
+		}
+		return static_cast<std::size_t>(read);
+	}
+	/**
+	 * @return where send() sends to: the remote of a client's stream or,
+	 * for a server's stream, the sender of the datagram being read
+	 *
+	 * @throws std::runtime_error if a server has not received anything yet
+	 */
+	const sockaddr* default_destination(socklen_t& len) const {
+		if (_addrinfos.p != nullptr) {
+			len = _addrinfos.p->ai_addrlen;
+			return _addrinfos.p->ai_addr;
+		}
+		if (_peer.len == 0) {
+			throw std::runtime_error {"no datagram received to reply to"};
+		}
+		len = _peer.len;
+		return &_peer.addr.sa;
+	}
+	/**
+	 * sends the send buffer as one datagram
+	 *
+	 * @throws std::system_error if ::sendto() encountered an error
+	 */
+	void send_datagram(const sockaddr* to, socklen_t len) {
+		std::chrono::milliseconds timeout {INET_MAX_SEND_TIMEOUT_MS};
+		auto t_end = std::chrono::steady_clock::now() + timeout;
+		uint32_t crc = _checksum ? htonl(crc32c(_send_buf.data(), _send_buf.size())) : 0;
+		iovec iov[2];
+		iov[0].iov_base = _send_buf.data();
+		iov[0].iov_len = _send_buf.size();
+		iov[1].iov_base = &crc;
+		iov[1].iov_len = sizeof crc;
+		msghdr msg {};
+		msg.msg_name = const_cast<sockaddr*>(to);
+		msg.msg_namelen = len;
+		msg.msg_iov = iov;
+		msg.msg_iovlen = _checksum ? 2 : 1;
+		while (::sendmsg(_socket_fd, &msg, 0) == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			if (!wait_ready(_socket_fd, POLLOUT, t_end)) {
+				throw std::runtime_error {"timeout reached"};
+			}
+		}
+	}
+	/**
+	 * checks the datagram of sz bytes at offset against the CRC32C in its
+	 * last four bytes and counts it if they do not match
+	 *
+	 * @return size without the checksum, -1 if the datagram is to be dropped
+	 */
+	std::size_t strip_checksum(std::size_t offset, std::size_t sz) {
+		uint32_t crc {};
+		if (sz >= sizeof crc) {
+			sz -= sizeof crc;
+			std::memcpy(&crc, _recv_buf.data() + offset + sz, sizeof crc);
+			if (ntohl(crc) == crc32c(_recv_buf.data() + offset, sz)) {
+				return sz;
+			}
+		}
+		++_checksum_failures;
+		return static_cast<std::size_t>(-1);
+	}
+	/**
+	 * appends sz bytes at p to the send buffer in one go
+	 */
+	void append(const void* p, std::size_t sz) {
+		if (sz == 0) {
+			return;
+		}
+		std::size_t old_sz = _send_buf.size();
+		_send_buf.resize(old_sz + sz);
+		std::memcpy(_send_buf.data() + old_sz, p, sz);
+	}
+	friend class server<P>;
+	friend class client<P>;
+	friend class event_loop;
+	friend class uring;
+	friend class async_stream;
+	int _socket_fd;
+	addrinfos _addrinfos;
+	std::shared_ptr<buffer_pool> _pool;
+	buffer _send_buf;
+	buffer _recv_buf;
+	// offset of the next byte to read in _recv_buf
+	std::size_t _read_pos;
+	bool _owns;
+	bool _eof;
+	// set while recv_message() limits reading to one message
+	bool _in_message;
+	std::size_t _message_end;
+	std::size_t _read_size;
+	bool _adaptive_read;
+	bool _terminate_strings;
+	// compresses messages, see set_codec()
+	std::shared_ptr<const codec> _codec;
+	std::size_t _compress_min;
+	// scratch space of send_compressed()
+	buffer _compress_buf;
+	// CRC32C on messages and datagrams, see set_checksum()
+	bool _checksum;
+	std::size_t _checksum_failures;
+	// where received datagrams start and who sent them, UDP only
+	struct datagram {
+		std::size_t offset, size;
+		endpoint from;
+	};
+	std::vector<datagram> _datagrams;
+	// first datagram next_datagram() has not handed out yet
+	std::size_t _next_datagram;
+	// ends and, unless len is 0, destinations of the datagrams queued by
+	// queue_datagram()
+	struct send_mark {
+		std::size_t end;
+		endpoint to;
+	};
+	std::vector<send_mark> _send_marks;
+	// sender of the datagram being read, or client of an accepted stream
+	endpoint _peer;
+	// buffers queued by write_ref() and where they go in _send_buf, TCP only
+	struct segment {
+		std::size_t at;
+		const byte* p;
+		std::size_t sz;
+		std::shared_ptr<const void> owner;
+	};
+	std::vector<segment> _segments;
+	// zero-copy sends up to send call number last and the buffers they read
+	struct zc_send {
+		uint32_t last;
+		std::vector<std::shared_ptr<const void>> owners;
+	};
+	bool _zerocopy;
+	uint32_t _zc_next;
+	std::deque<zc_send> _zc_pending;
+	// reused arguments of ::sendmsg(), ::recvmmsg() and ::sendmmsg()
+	std::vector<mmsghdr> _mmsgs;
+	std::vector<iovec> _iovs;
+};
+
+template <protocol P>
+class server {
+public:
+	/**
+	 * listens on Port with room for backlog pending clients. with
+	 * reuse_port several servers can listen on the same port and the kernel
+	 * spreads new clients across them, see acceptor_pool.
+	 *
+	 * @throws std::system_error if the socket could not be set up
+	 */
+	template <protocol T = P, typename std::enable_if<is_tcp_prot<T>::value, int>::type* = nullptr>
+	server(unsigned short Port, int backlog = INET_MAX_CONNECTIONS, bool reuse_port = false)
+		: _port {Port}, _addrinfos {nullptr, nullptr}, _nonblocking {false},
+		  _pool {std::make_shared<inet::buffer_pool>()} {
+		if (INET_USE_DEFAULT_SIGUSR1_HANDLER) {
+			struct sigaction sa;
+			sa.sa_handler = sigusr1_handler;
+			sigemptyset(&sa.sa_mask);
+			sa.sa_flags = 0;
+			if (sigaction(SIGUSR1, &sa, NULL) != 0) {
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+		}
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof hints);
+		if (INET_IPV == 4) {
+			hints.ai_family = AF_INET;
+		}
+		else if (INET_IPV == 6) {
+			hints.ai_family = AF_INET6;
+		}
+		else {
+			hints.ai_family = AF_UNSPEC;
+		}
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		char port[6] = {0};
+		std::stringstream ss;
+		ss << _port;
+		ss >> port;
+		port[5] = 0;
+		int rv = getaddrinfo(NULL, port, &hints, &_addrinfos.infos);
+		if (rv != 0) {
+			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		}
+		for (_addrinfos.p = _addrinfos.infos; _addrinfos.p != NULL; _addrinfos.p = _addrinfos.p->ai_next) {
+			_socket_fd = socket(_addrinfos.p->ai_family, _addrinfos.p->ai_socktype, _addrinfos.p->ai_protocol);
+			if (_socket_fd == -1) {
+				// swallow error
+				continue;
+			}
+			int yes = 1; rv = 0;
+			rv = setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int));
+			if (rv == 0 && reuse_port) {
+				rv = setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int));
+			}
+			if (rv == -1) {
+				close(_socket_fd);
+				freeaddrinfo(_addrinfos.infos);
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			if (bind(_socket_fd, _addrinfos.p->ai_addr, _addrinfos.p->ai_addrlen) == -1) {
+				close(_socket_fd);
+				// swallow error
+				continue;
+			}
+			break;
+		}
+		if (_addrinfos.p == NULL) {
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		if (listen(_socket_fd, backlog) == -1) {
+			close(_socket_fd);
+			freeaddrinfo(_addrinfos.infos);
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+	}
+	template <protocol T = P, typename std::enable_if<is_udp_prot<T>::value, int>::type* = nullptr>
+	server(unsigned short Port) : _port {Port}, _addrinfos {nullptr, nullptr}, _nonblocking {false} {
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof hints);
+		if (INET_IPV == 4) {
+			hints.ai_family = AF_INET;
+		}
+		else if (INET_IPV == 6) {
+			hints.ai_family = AF_INET6;
+		}
+		else {
+			hints.ai_family = AF_UNSPEC;
+		}
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_flags = AI_PASSIVE;
+		char port[6] = {0};
+		std::stringstream ss;
+		ss << _port;
+		ss >> port;
+		port[5] = 0;
+		int rv = getaddrinfo(NULL, port, &hints, &_addrinfos.infos);
+		if (rv != 0) {
+			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		}
+		for (_addrinfos.p = _addrinfos.infos; _addrinfos.p != NULL; _addrinfos.p = _addrinfos.p->ai_next) {
+			_socket_fd = socket(_addrinfos.p->ai_family, _addrinfos.p->ai_socktype, _addrinfos.p->ai_protocol);
+			if (_socket_fd == -1) {
+				// swallow error
+				continue;
+			}
+			if (bind(_socket_fd, _addrinfos.p->ai_addr, _addrinfos.p->ai_addrlen) == -1) {
+				close(_socket_fd);
+				// swallow error
+				continue;
+			}
+			break;
+		}
+		if (_addrinfos.p == NULL) {
+			freeaddrinfo(_addrinfos.infos);
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+	}
+	~server() {
+		close(_socket_fd); _socket_fd = -1;
+		freeaddrinfo(_addrinfos.infos);
+		_addrinfos.infos = _addrinfos.p = nullptr;
+	}
+	/**
+	 * set the underlying socket to non-blocking mode.
+	 * @throws std::system_error if an error occurs
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value>::type set_nonblocking() {
+		int flags = fcntl(_socket_fd, F_GETFL);
+		if (flags == -1 || fcntl(_socket_fd, F_SETFL, flags | O_NONBLOCK)) {
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		_nonblocking = true;
+	}
+	/**
+	 * if using select() before set_nonblocking() has been called, the
+	 * behaviour is undefined.
+	 *
+	 * blocks while now() < time_of_call + timeout and checks if a client
+	 * can be accept()-ed without blocking.
+	 *
+	 * @param timeout duration for which to wait for client to connect()
+	 *
+	 * @return early true if client can be accept()-ed or false after
+	 * timeout expired otherwise
+	 *
+	 * @throws std::system_error if ::ppoll() encounters an error
+	 *
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, bool>::type
+	select(std::chrono::milliseconds timeout) const {
+		return wait_ready(_socket_fd, POLLIN, std::chrono::steady_clock::now() + timeout);
+	}
+	/**
+	 * blocks until a client connects.
+	 *
+	 * @throws std::system_error if ::accept() was interrupted by a signal
+	 * or the connection could not established cleanly
+	 *
+	 * @return inetstream to the connected client
+	 */
+	// enables "accept" if protocol is TCP
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, inetstream<protocol::TCP>>::type accept() {
+		endpoint from;
+		int new_fd = this->accept_fd(/*would_block_ok*/false, from);
+		return this->make_stream(new_fd, from);
+	}
+	/**
+	 * accepts every client pending right now, so a single wakeup serves a
+	 * whole burst of connects. clients that gave up before being accepted
+	 * are skipped.
+	 *
+	 * @throws std::runtime_error if the server is not in non-blocking mode,
+	 * see set_nonblocking()
+	 * @throws std::system_error if ::accept4() failed before any client
+	 * was accepted
+	 *
+	 * @return inetstreams to the accepted clients, possibly none
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, std::vector<inetstream<protocol::TCP>>>::type
+	accept_all() {
+		if (!_nonblocking) {
+			throw std::runtime_error {"accept_all() needs a non-blocking server"};
+		}
+		std::vector<inetstream<protocol::TCP>> accepted;
+		while (true) {
+			endpoint from;
+			int fd {-1};
+			try {
+				fd = this->accept_fd(/*would_block_ok*/true, from);
+			}
+			catch (const std::system_error& e) {
+				if (e.code().value() == ECONNABORTED) {
+					continue;
+				}
+				if (accepted.empty()) {
+					throw;
+				}
+				// the error comes up again on the next call
+				break;
+			}
+			if (fd == -1) {
+				break;
+			}
+			accepted.push_back(this->make_stream(fd, from));
+		}
+		return accepted;
+	}
+	/**
+	 * replace the pool the buffers of accepted streams come from. null makes
+	 * them use the heap.
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, void>::type
+	set_buffer_pool(std::shared_ptr<inet::buffer_pool> pool) {
+		_pool = std::move(pool);
+	}
+	const std::shared_ptr<inet::buffer_pool>& get_buffer_pool() const { return _pool; }
+	/**
+	 *
+	 * @return inetstream to this end of the communication
+	 */
+	// enables "get_inetstream" if protocol is UDP
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, inetstream<protocol::UDP>>::type
+	get_inetstream() {
+		// don't transfer ownership. without a remote, send() answers whoever
+		// sent the datagram being read
+		return inetstream<protocol::UDP> {_socket_fd, {nullptr, nullptr}, /*owns*/false};
+	}
+private:
+	friend class event_loop;
+	friend class acceptor_pool;
+	friend class runtime;
+	friend class uring;
+	/**
+	 * accepts a pending client with a non-blocking, close-on-exec socket in
+	 * a single syscall. its address is kept as is, formatting it is left to
+	 * whoever asks for it.
+	 *
+	 * @param would_block_ok return -1 instead of throwing if the listening
+	 * socket is non-blocking and no client is pending
+	 * @param from receives the address of the client
+	 *
+	 * @return the connected socket
+	 */
+	int accept_fd(bool would_block_ok, endpoint& from) {
+		from.len = sizeof from.addr;
+		int new_fd = ::accept4(_socket_fd, &from.addr.sa, &from.len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (new_fd == -1) {
+			if (would_block_ok && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				return -1;
+			}
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		return new_fd;
+	}
+	inetstream<protocol::TCP> make_stream(int fd, const endpoint& from) {
+		inetstream<protocol::TCP> istr {fd, {nullptr, nullptr}, /*owns*/true};
+		istr._peer = from;
+		istr.set_buffer_pool(_pool);
+		return istr;
+	}
+	unsigned short _port;
+	int _socket_fd;
+	addrinfos _addrinfos;
+	bool _nonblocking;
+	// shared by all accepted streams
+	std::shared_ptr<inet::buffer_pool> _pool;
+};
+
+template <protocol P>
+class client {
+public:
+	template <protocol T = P, typename std::enable_if<is_tcp_prot<T>::value, int>::type* = nullptr>
+	client(const std::string& Host, unsigned short Port)
+		: _host {Host}, _port {Port} {}
+	template <protocol T = P, typename std::enable_if<is_udp_prot<T>::value, int>::type* = nullptr>
+	client (const std::string& Host, unsigned short Port)
+		: _host {Host}, _port {Port} {}
+	/**
+	 * connect the client to the server specified via the constructor,
+	 * giving up after INET_CONNECT_TIMEOUT_MS
+	 *
+	 * @throws std::runtime_error if the timeout was reached
+	 * @throws std::system_error if connection was not possible for some
+	 * reason
+	 *
+	 * @return inetstream to the connected server
+	 */
+	// enables "connect" if protocol is TCP
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, inetstream<protocol::TCP>>::type
+	connect() {
+		return this->connect(std::chrono::milliseconds {INET_CONNECT_TIMEOUT_MS});
+	}
+	/**
+	 * same as above but gives up after timeout. if the host resolves to
+	 * several addresses they are raced against each other, see
+	 * race_connect(), alternating between IPv6 and IPv4 starting with the
+	 * family the resolver put first.
+	 *
+	 * @param stagger how long to wait for one address before trying the
+	 * next one as well
+	 */
+	template <protocol T = P>
+	typename std::enable_if<is_tcp_prot<T>::value, inetstream<protocol::TCP>>::type
+	connect(std::chrono::milliseconds timeout,
+	        std::chrono::milliseconds stagger = std::chrono::milliseconds {INET_CONNECT_STAGGER_MS}) {
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof hints);
+		if (INET_IPV == 4) {
+			hints.ai_family = AF_INET;
+		}
+		else if (INET_IPV == 6) {
+			hints.ai_family = AF_INET6;
+		}
+		else {
+			hints.ai_family = AF_UNSPEC;
+		}
+		hints.ai_socktype = SOCK_STREAM;
+		char port[6] = {0};
+		std::stringstream ss;
+		ss << _port;
+		ss >> port;
+		port[5] = 0;
+		addrinfo* infos, *p;
+		int rv = getaddrinfo(_host.c_str(), port, &hints, &infos);
+		if (rv != 0) {
+			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		}
+		// alternate address families, keeping the resolver's order otherwise
+		std::vector<addrinfo*> first, other;
+		for (p = infos; p != NULL; p = p->ai_next) {
+			if (p->ai_addrlen <= sizeof(endpoint::addr)) {
+				(p->ai_family == infos->ai_family ? first : other).push_back(p);
+			}
+		}
+		std::vector<addrinfo*> order;
+		for (std::size_t i {0}; i < std::max(first.size(), other.size()); ++i) {
+			if (i < first.size()) {
+				order.push_back(first[i]);
+			}
+			if (i < other.size()) {
+				order.push_back(other[i]);
+			}
+		}
+		std::vector<endpoint> addrs(order.size());
+		for (std::size_t i {0}; i < order.size(); ++i) {
+			std::memcpy(&addrs[i].addr, order[i]->ai_addr, order[i]->ai_addrlen);
+			addrs[i].len = order[i]->ai_addrlen;
+		}
+		std::size_t winner {0};
+		try {
+			_socket_fd = race_connect(addrs, deadline, stagger, &winner);
+		}
+		catch (...) {
+			freeaddrinfo(infos);
+			throw;
+		}
+		p = order[winner];
+		inetstream<protocol::TCP> istr {_socket_fd, addrinfos {infos, p}, /*owns*/true};
+		istr._peer = addrs[winner];
+		return istr;
+	}
+	/**
+	 * @throws std::system_error if communication could not be established
+	 * @return inetstream to this end of the communication
+	 */
+	// enables "get_inetstream" if protocol is UDP
+	template <protocol T = P>
+	typename std::enable_if<is_udp_prot<T>::value, inetstream<protocol::UDP>>::type
+	get_inetstream() {
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof hints);
+		if (INET_IPV == 4) {
+			hints.ai_family = AF_INET;
+		}
+		else if (INET_IPV == 6) {
+			hints.ai_family = AF_INET6;
+		}
+		else {
+			hints.ai_family = AF_UNSPEC;
+		}
+		hints.ai_socktype = SOCK_DGRAM;
+		char port[6] = {0};
+		std::stringstream ss;
+		ss << _port;
+		ss >> port;
+		port[5] = 0;
+		addrinfo* infos, *p;
+		int rv = getaddrinfo(_host.c_str(), port, &hints, &infos);
+		if (rv != 0) {
+			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		}
+		for (p = infos; p != NULL; p = p->ai_next) {
+			_socket_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+			if (_socket_fd == -1) {
+				// swallow error
+				continue;
+			}
+			break;
+		}
+		if (p == NULL) {
+			freeaddrinfo(infos);
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		return inetstream<protocol::UDP> {_socket_fd, addrinfos {infos, p}, /*owns*/true};
+	}
+private:
+	std::string _host;
+	unsigned short _port;
+	int _socket_fd;
+};
+/**
+ * dispatches readiness of many TCP endpoints from a single thread using
+ * edge-triggered epoll
+ *
+ * registered servers and inetstreams are referenced, not owned: they must
+ * neither be moved nor destroyed before being remove()-d again. since
+ * notifications are edge-triggered, readable handlers have to drain the
+ * socket, e.g. by calling recv(sz, std::chrono::milliseconds {0}) until it
+ * returns less than requested.
+ */
+class event_loop {
+public:
+	typedef std::function<void(inetstream<protocol::TCP>&&)> accept_handler;
+	typedef std::function<void(inetstream<protocol::TCP>&)> stream_handler;
+	typedef std::function<void()> fd_handler;
+	/**
+	 * @throws std::system_error if the epoll instance could not be created
+	 */
+	event_loop() : _epoll_fd {epoll_create1(EPOLL_CLOEXEC)}, _running {false}, _events(64) {
+		if (_epoll_fd == -1) {
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+	}
+	event_loop(const event_loop&) = delete;
+	event_loop& operator=(const event_loop&) = delete;
+	~event_loop() {
+		close(_epoll_fd);
+	}
+	/**
+	 * watch a listening server. the loop accepts every pending client
+	 * itself and hands the resulting inetstream over to on_accept.
+	 *
+	 * clients that gave up before being accepted are skipped. if accepting
+	 * fails otherwise, e.g. for lack of descriptors, the loop tries again
+	 * after accept_retry_ms, as the edge-triggered socket would not report
+	 * the waiting clients again.
+	 *
+	 * puts the server into non-blocking mode.
+	 *
+	 * @throws std::system_error if the server could not be registered
+	 */
+	void add(server<protocol::TCP>& s, accept_handler on_accept) {
+		s.set_nonblocking();
+		std::unique_ptr<entry> e {new entry {}};
+		e->srv = &s;
+		e->on_accept = std::move(on_accept);
+		this->watch(s._socket_fd, EPOLLIN | EPOLLET, std::move(e));
+	}
+	/**
+	 * watch a connected inetstream. on_readable is also called once remote
+	 * hung up, recv() then sets eof().
+	 *
+	 * @param on_writable optional, called whenever the socket can be
+	 * written to again
+	 *
+	 * @throws std::system_error if the inetstream could not be registered
+	 */
+	void add(inetstream<protocol::TCP>& istr, stream_handler on_readable,
+	         stream_handler on_writable = nullptr) {
+		uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+		if (on_writable) {
+			events |= EPOLLOUT;
+		}
+		std::unique_ptr<entry> e {new entry {}};
+		e->istr = &istr;
+		e->on_readable = std::move(on_readable);
+		e->on_writable = std::move(on_writable);
+		this->watch(istr._socket_fd, events, std::move(e));
+	}
+	/**
+	 * watch any other readable file descriptor, e.g. an eventfd. fd stays
+	 * owned by the caller.
+	 *
+	 * @throws std::system_error if fd could not be registered
+	 */
+	void add(int fd, fd_handler on_readable) {
+		std::unique_ptr<entry> e {new entry {}};
+		e->on_fd = std::move(on_readable);
+		this->watch(fd, EPOLLIN | EPOLLET, std::move(e));
+	}
+	void remove(server<protocol::TCP>& s) { this->unwatch(s._socket_fd); }
+	void remove(inetstream<protocol::TCP>& istr) { this->unwatch(istr._socket_fd); }
+	void remove(int fd) { this->unwatch(fd); }
+	/**
+	 * @return number of registered servers and inetstreams
+	 */
+	std::size_t size() const { return _entries.size(); }
+	/**
+	 * waits for readiness and calls the handlers of all ready endpoints
+	 *
+	 * @param timeout duration for which to wait, negative waits forever
+	 *
+	 * @return number of endpoints that were ready, none if a signal
+	 * interrupted the wait
+	 *
+	 * @throws std::system_error if ::epoll_wait() encounters an error
+	 */
+	std::size_t run_once(std::chrono::milliseconds timeout) {
+		this->retry_accepts();
+		if (!_stalled.empty()) {
+			// wake up in time to retry
+			std::chrono::milliseconds until = std::max(std::chrono::milliseconds {0},
+			    std::chrono::duration_cast<std::chrono::milliseconds>(
+			        _accept_retry - std::chrono::steady_clock::now()) + std::chrono::milliseconds {1});
+			if (timeout.count() < 0 || timeout > until) {
+				timeout = until;
+			}
+		}
+		int timeout_ms = timeout.count() < 0 ? -1 : static_cast<int>(timeout.count());
+		int n = epoll_wait(_epoll_fd, _events.data(), static_cast<int>(_events.size()), timeout_ms);
+		if (n == -1) {
+			if (errno != EINTR) {
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			// woken up by a signal, nothing is ready
+			n = 0;
+		}
+		for (int i {0}; i < n; ++i) {
+			entry* e = static_cast<entry*>(_events[i].data.ptr);
+			// an earlier handler of this batch may have removed it
+			if (e->removed) {
+				continue;
+			}
+			uint32_t ev = _events[i].events;
+			if (e->srv) {
+				this->accept_all(*e);
+				continue;
+			}
+			if (e->on_fd) {
+				e->on_fd();
+				continue;
+			}
+			if ((ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && e->on_readable) {
+				e->on_readable(*e->istr);
+			}
+			if ((ev & EPOLLOUT) && !e->removed && e->on_writable) {
+				e->on_writable(*e->istr);
+			}
+		}
+		this->retry_accepts();
+		_removed.clear();
+		if (static_cast<std::size_t>(n) == _events.size()) {
+			_events.resize(_events.size() * 2);
+		}
+		return static_cast<std::size_t>(n);
+	}
+	/**
+	 * dispatches events until stop() is called from within a handler
+	 */
+	void run() {
+		_running = true;
+		while (_running) {
+			this->run_once(std::chrono::milliseconds {-1});
+		}
+	}
+	void stop() { _running = false; }
+	// how long to wait before accepting again once accepting failed
+	enum : int { accept_retry_ms = 100 };
+private:
+	struct entry {
+		int fd;
+		server<protocol::TCP>* srv;
+		inetstream<protocol::TCP>* istr;
+		accept_handler on_accept;
+		stream_handler on_readable;
+		stream_handler on_writable;
+		fd_handler on_fd;
+		bool removed;
+		// waiting in _stalled to accept again
+		bool stalled;
+	};
+	void watch(int fd, uint32_t events, std::unique_ptr<entry> e) {
+		e->fd = fd;
+		epoll_event ev {};
+		ev.events = events;
+		ev.data.ptr = e.get();
+		if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		_entries[fd] = std::move(e);
+	}
+	void unwatch(int fd) {
+		auto it = _entries.find(fd);
+		if (it == _entries.end()) {
+			return;
+		}
+		// fd may already be closed, which removes it from the epoll set anyway
+		epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		it->second->removed = true;
+		// keep entry alive until the current batch has been dispatched
+		_removed.push_back(std::move(it->second));
+		_entries.erase(it);
+	}
+	void accept_all(entry& e) {
+		while (!e.removed) {
+			endpoint from;
+			int fd {-1};
+			try {
+				fd = e.srv->accept_fd(/*would_block_ok*/true, from);
+			}
+			catch (const std::system_error& err) {
+				if (err.code().value() == ECONNABORTED) {
+					continue;
+				}
+				if (!e.stalled) {
+					e.stalled = true;
+					_stalled.push_back(e.fd);
+				}
+				_accept_retry = std::chrono::steady_clock::now() + std::chrono::milliseconds {accept_retry_ms};
+				return;
+			}
+			if (fd == -1) {
+				break;
+			}
+			e.on_accept(e.srv->make_stream(fd, from));
+		}
+	}
+	/**
+	 * accepts again on stalled servers once _accept_retry has come
+	 */
+	void retry_accepts() {
+		if (_stalled.empty() || std::chrono::steady_clock::now() < _accept_retry) {
+			return;
+		}
+		std::vector<int> stalled;
+		stalled.swap(_stalled);
+		for (int fd : stalled) {
+			// the server may have been removed in the meantime
+			auto it = _entries.find(fd);
+			if (it != _entries.end()) {
+				entry& e = *it->second;
+				e.stalled = false;
+				this->accept_all(e);
+			}
+		}
+	}
+	int _epoll_fd;
+	bool _running;
+	std::vector<epoll_event> _events;
+	std::unordered_map<int, std::unique_ptr<entry>> _entries;
+	std::vector<std::unique_ptr<entry>> _removed;
+	// servers that failed to accept, retried at _accept_retry
+	std::vector<int> _stalled;
+	std::chrono::steady_clock::time_point _accept_retry;
+};
+/**
+ * restricts t to the n-th cpu this process may run on, wrapping around.
+ * failing is not an error, the thread just keeps running anywhere.
+ */
+inline void pin_to_cpu(std::thread& t, std::size_t n) {
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof allowed, &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+		return;
+	}
+	n %= static_cast<std::size_t>(CPU_COUNT(&allowed));
+	for (int cpu {0}; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+			cpu_set_t one;
+			CPU_ZERO(&one);
+			CPU_SET(cpu, &one);
+			pthread_setaffinity_np(t.native_handle(), sizeof one, &one);
+			return;
+		}
+	}
+}
+/**
+ * accepts clients of one TCP port on several threads. every worker has a
+ * listening socket of its own, bound with SO_REUSEPORT, so the kernel
+ * spreads new clients across them instead of queueing all of them on a
+ * single socket. workers are pinned to one cpu each where possible.
+ *
+ * on_accept runs on the worker that accepted the client, which accepts no
+ * one else in the meantime. it should hand long lived connections on to
+ * other threads. whatever it throws goes to the error handler.
+ */
+class acceptor_pool {
+public:
+	typedef std::function<void(inetstream<protocol::TCP>&&)> accept_handler;
+	typedef std::function<void(std::exception_ptr)> error_handler;
+	/**
+	 * opens the listening sockets, clients can connect from here on
+	 *
+	 * @param workers number of listening sockets and threads, 0 uses one
+	 * per cpu
+	 * @param backlog pending clients every listening socket has room for
+	 *
+	 * @throws std::system_error if a socket could not be set up
+	 */
+	acceptor_pool(unsigned short port, std::size_t workers = 0, int backlog = INET_MAX_CONNECTIONS)
+		: _running {false} {
+		if (workers == 0) {
+			workers = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (std::size_t i {0}; i < workers; ++i) {
+			_listeners.emplace_back(new server<protocol::TCP> {port, backlog, /*reuse_port*/true});
+			_listeners.back()->set_nonblocking();
+		}
+	}
+	acceptor_pool(const acceptor_pool&) = delete;
+	acceptor_pool& operator=(const acceptor_pool&) = delete;
+	~acceptor_pool() {
+		this->stop();
+	}
+	/**
+	 * starts one thread per listening socket that calls on_accept for every
+	 * client
+	 *
+	 * @throws std::runtime_error if already started
+	 */
+	void start(accept_handler on_accept) {
+		if (_running.exchange(true)) {
+			throw std::runtime_error {"acceptor_pool already started"};
+		}
+		_on_accept = std::move(on_accept);
+		for (std::size_t i {0}; i < _listeners.size(); ++i) {
+			_threads.emplace_back(&acceptor_pool::work, this, _listeners[i].get());
+			pin_to_cpu(_threads.back(), i);
+		}
+	}
+	/**
+	 * stops accepting and waits for the workers to finish their current
+	 * on_accept. clients pending on the sockets are left unaccepted.
+	 */
+	void stop() {
+		_running = false;
+		for (auto& t : _threads) {
+			t.join();
+		}
+		_threads.clear();
+	}
+	std::size_t workers() const { return _listeners.size(); }
+	/**
+	 * on_error receives whatever on_accept throws, on the worker that ran
+	 * it. without one such exceptions are dropped. must be set before
+	 * start().
+	 */
+	void set_error_handler(error_handler on_error) {
+		_on_error = std::move(on_error);
+	}
+	/**
+	 * replace the pool the buffers of accepted streams come from, must be
+	 * called before start()
+	 */
+	void set_buffer_pool(std::shared_ptr<buffer_pool> pool) {
+		for (auto& l : _listeners) {
+			l->set_buffer_pool(pool);
+		}
+	}
+private:
+	// how often workers check whether they are to stop
+	static constexpr const int stop_poll_ms {50};
+	// how long to wait before accepting again once accepting failed
+	enum : int { accept_retry_ms = 100 };
+	void work(server<protocol::TCP>* srv) {
+		while (_running) {
+			if (!wait_ready(srv->_socket_fd, POLLIN,
+			                std::chrono::steady_clock::now() + std::chrono::milliseconds {stop_poll_ms})) {
+				continue;
+			}
+			while (_running) {
+				endpoint from;
+				int fd {-1};
+				try {
+					fd = srv->accept_fd(/*would_block_ok*/true, from);
+				}
+				catch (const std::system_error& e) {
+					if (e.code().value() == ECONNABORTED) {
+						continue;
+					}
+					// out of descriptors or memory. the client stays pending
+					// and keeps the socket readable, so wait instead of spinning
+					std::this_thread::sleep_for(std::chrono::milliseconds {accept_retry_ms});
+					break;
+				}
+				if (fd == -1) {
+					break;
+				}
+				try {
+					_on_accept(srv->make_stream(fd, from));
+				}
+				catch (...) {
+					if (_on_error) {
+						_on_error(std::current_exception());
+					}
+				}
+			}
+		}
+	}
+	std::vector<std::unique_ptr<server<protocol::TCP>>> _listeners;
+	std::vector<std::thread> _threads;
+	std::atomic<bool> _running;
+	accept_handler _on_accept;
+	error_handler _on_error;
+};
+/**
+ * thread-per-core TCP server runtime. a fixed set of workers each runs an
+ * event_loop on a thread pinned to one cpu, with listening sockets of its
+ * own (see acceptor_pool) and the connections it accepted. a connection
+ * never leaves its worker, so its handler needs no locking.
+ *
+ * cpu heavy work is spawn()-ed as a task. tasks queue up on the worker
+ * that spawned them, idle workers steal from the other end of busy
+ * workers' queues.
+ */
+class runtime {
+public:
+	typedef std::function<void(inetstream<protocol::TCP>&)> connection_handler;
+	typedef std::function<void()> task;
+	typedef std::function<void(std::exception_ptr)> error_handler;
+	/**
+	 * @param workers number of threads, 0 uses one per cpu
+	 *
+	 * @throws std::system_error if an event_loop or eventfd could not be
+	 * created
+	 */
+	explicit runtime(std::size_t workers = 0) : _running {false}, _next {0}, _connections {0} {
+		if (workers == 0) {
+			workers = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (std::size_t i {0}; i < workers; ++i) {
+			_workers.emplace_back(new worker {});
+			worker& w = *_workers.back();
+			w.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (w.wake_fd == -1) {
+				throw std::system_error {errno, std::system_category(), strerror(errno)};
+			}
+			int fd = w.wake_fd;
+			w.loop.add(fd, [fd] {
+				uint64_t n;
+				while (::read(fd, &n, sizeof n) > 0) {}
+			});
+		}
+	}
+	runtime(const runtime&) = delete;
+	runtime& operator=(const runtime&) = delete;
+	~runtime() {
+		this->stop();
+		for (auto& w : _workers) {
+			w->loop.remove(w->wake_fd);
+			close(w->wake_fd);
+		}
+	}
+	/**
+	 * accept clients on port on every worker. on_data is called on the
+	 * accepting worker whenever data arrived, after what is available has
+	 * been received into the stream, up to 256 KB per call. it reads what it
+	 * can use and leaves the rest for the next call. the connection is
+	 * closed once remote hung up or on_data throws, what it threw goes to
+	 * the error handler.
+	 *
+	 * may be called before or after start()
+	 *
+	 * @throws std::system_error if a listening socket could not be set up
+	 */
+	void listen(unsigned short port, connection_handler on_data, int backlog = INET_MAX_CONNECTIONS) {
+		auto h = std::make_shared<connection_handler>(std::move(on_data));
+		for (std::size_t i {0}; i < _workers.size(); ++i) {
+			std::shared_ptr<server<protocol::TCP>> srv {new server<protocol::TCP> {port, backlog, /*reuse_port*/true}};
+			srv->set_nonblocking();
+			worker* w = _workers[i].get();
+			this->post(i, [this, w, srv, h] {
+				w->listeners.push_back(srv);
+				w->loop.add(*srv, [this, w, h](inetstream<protocol::TCP>&& accepted) {
+					this->adopt(*w, std::move(accepted), h);
+				});
+			});
+		}
+	}
+	/**
+	 * on_error receives whatever a spawn()-ed or post()-ed task or a
+	 * connection handler throws, including errors receiving, on the worker
+	 * that ran it. without one such exceptions are dropped. must be set
+	 * before start().
+	 */
+	void set_error_handler(error_handler on_error) {
+		_on_error = std::move(on_error);
+	}
+	/**
+	 * starts the workers
+	 *
+	 * @throws std::runtime_error if already started
+	 */
+	void start() {
+		if (_running.exchange(true)) {
+			throw std::runtime_error {"runtime already started"};
+		}
+		for (std::size_t i {0}; i < _workers.size(); ++i) {
+			_workers[i]->thread = std::thread {&runtime::work, this, i};
+			pin_to_cpu(_workers[i]->thread, i);
+		}
+	}
+	/**
+	 * stops the workers after their current handler or task. queued tasks
+	 * are dropped, connections stay open until the runtime is destroyed.
+	 */
+	void stop() {
+		_running = false;
+		for (auto& w : _workers) {
+			this->wake(*w);
+		}
+		for (auto& w : _workers) {
+			if (w->thread.joinable()) {
+				w->thread.join();
+			}
+		}
+	}
+	/**
+	 * runs t on the given worker, e.g. to hand the result of a task back to
+	 * a connection
+	 */
+	void post(std::size_t worker_index, task t) {
+		worker& w = *_workers.at(worker_index);
+		{
+			std::lock_guard<std::mutex> lock {w.m};
+			w.posted.push_back(std::move(t));
+		}
+		if (current_worker() != worker_index) {
+			this->wake(w);
+		}
+	}
+	/**
+	 * runs t on the calling worker, or on any other worker that runs out of
+	 * work first. from outside the runtime, workers take turns.
+	 */
+	void spawn(task t) {
+		std::size_t self = current_worker();
+		std::size_t i = self != npos ? self : _next++ % _workers.size();
+		worker& w = *_workers[i];
+		bool backlog;
+		{
+			std::lock_guard<std::mutex> lock {w.m};
+			backlog = !w.tasks.empty();
+			w.tasks.push_back(std::move(t));
+		}
+		if (i != self) {
+			this->wake(w);
+		}
+		if (backlog && _workers.size() > 1) {
+			// let a sibling steal
+			this->wake(*_workers[(i + 1 + _next++ % (_workers.size() - 1)) % _workers.size()]);
+		}
+	}
+	std::size_t workers() const { return _workers.size(); }
+	/**
+	 * @return number of open connections
+	 */
+	std::size_t connections() const { return _connections; }
+	enum : std::size_t { npos = static_cast<std::size_t>(-1) };
+	/**
+	 * @return index of the worker running the caller, npos outside of this
+	 * runtime's workers
+	 */
+	std::size_t current_worker() const {
+		return current().rt == this ? current().index : npos;
+	}
+private:
+	struct connection {
+		std::unique_ptr<inetstream<protocol::TCP>> istr;
+		std::shared_ptr<connection_handler> on_data;
+	};
+	struct worker {
+		event_loop loop;
+		int wake_fd;
+		std::mutex m;
+		// tasks that have to run on this worker
+		std::vector<task> posted;
+		// spawned tasks, the owner takes from the back, thieves from the front
+		std::deque<task> tasks;
+		std::vector<std::shared_ptr<server<protocol::TCP>>> listeners;
+		std::unordered_map<inetstream<protocol::TCP>*, connection> conns;
+		// connections that used up their read_budget and have more to read
+		std::vector<inetstream<protocol::TCP>*> unfinished;
+		std::thread thread;
+	};
+	struct location {
+		const runtime* rt;
+		std::size_t index;
+	};
+	static location& current() {
+		static thread_local location l {nullptr, npos};
+		return l;
+	}
+	void wake(worker& w) {
+		uint64_t one {1};
+		ssize_t rv = ::write(w.wake_fd, &one, sizeof one);
+		// the counter is full only if the worker is already due to wake up
+		static_cast<void>(rv);
+	}
+	void run_task(task& t) {
+		try {
+			t();
 		}
-		for (_addrinfos.p = _addrinfos.infos; _addrinfos.p != NULL; _addrinfos.p = _addrinfos.p->ai_next) {
-			_socket_fd = socket(_addrinfos.p->ai_family, _addrinfos.p->ai_socktype, _addrinfos.p->ai_protocol);
-			if (_socket_fd == -1) {
-				// swallow error
-				continue;
+		catch (...) {
+			if (_on_error) {
+				_on_error(std::current_exception());
 			}
-			int yes = 1; rv = 0;
-			rv = setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int));
-			if (rv == -1) {
-				throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+	}
+	// bytes a connection may receive per turn, so a busy one cannot starve
+	// the others on its worker
+	enum : std::size_t { read_budget = 256 * 1024 };
+	void adopt(worker& w, inetstream<protocol::TCP>&& accepted, std::shared_ptr<connection_handler> h) {
+		std::unique_ptr<inetstream<protocol::TCP>> istr {new inetstream<protocol::TCP> {std::move(accepted)}};
+		inetstream<protocol::TCP>* p = istr.get();
+		w.conns[p] = connection {std::move(istr), std::move(h)};
+		++_connections;
+		w.loop.add(*p, [this, &w](inetstream<protocol::TCP>& s) { this->serve(w, s); });
+	}
+	/**
+	 * receives up to read_budget bytes and hands them to the connection's
+	 * handler. if that did not drain the socket, the connection is queued
+	 * to be served again after the others, since the edge-triggered socket
+	 * will not report the rest.
+	 */
+	void serve(worker& w, inetstream<protocol::TCP>& s) {
+		bool close {false}, more {false};
+		try {
+			std::size_t got = s.recv(read_budget, std::chrono::milliseconds {0});
+			if (!s.empty()) {
+				(*w.conns[&s].on_data)(s);
 			}
-			if (bind(_socket_fd, _addrinfos.p->ai_addr, _addrinfos.p->ai_addrlen) == -1) {
-				close(_socket_fd);
-				// swallow error
-				continue;
+			close = s.eof();
+			more = got == static_cast<std::size_t>(read_budget);
+		}
+		catch (...) {
+			close = true;
+			if (_on_error) {
+				_on_error(std::current_exception());
 			}
-			break;
 		}
-		if (_addrinfos.p == NULL) {
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		if (close) {
+			w.unfinished.erase(std::remove(w.unfinished.begin(), w.unfinished.end(), &s), w.unfinished.end());
+			w.loop.remove(s);
+			w.conns.erase(&s);
+			--_connections;
 		}
-		if (listen(_socket_fd, INET_MAX_CONNECTIONS) == -1) {
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		else if (more && std::find(w.unfinished.begin(), w.unfinished.end(), &s) == w.unfinished.end()) {
+			w.unfinished.push_back(&s);
 		}
 	}
-	template <protocol T = P, typename std::enable_if<is_udp_prot<T>::value, int>::type* = nullptr>
-	server(unsigned short Port) : _port {Port}, _addrinfos {nullptr, nullptr} {
-		addrinfo hints;
-		std::memset(&hints, 0, sizeof hints);
-		if (INET_IPV == 4) {
-			hints.ai_family = AF_INET;
+	void serve_unfinished(worker& w) {
+		std::vector<inetstream<protocol::TCP>*> unfinished;
+		unfinished.swap(w.unfinished);
+		for (inetstream<protocol::TCP>* p : unfinished) {
+			// serving one may have closed another
+			if (w.conns.count(p)) {
+				this->serve(w, *p);
+			}
 		}
-		else if (INET_IPV == 6) {
-			hints.ai_family = AF_INET6;
+	}
+	/**
+	 * @return false if neither w nor any other worker has a task queued
+	 */
+	bool next_task(std::size_t self, task& t) {
+		{
+			worker& w = *_workers[self];
+			std::lock_guard<std::mutex> lock {w.m};
+			if (!w.tasks.empty()) {
+				t = std::move(w.tasks.back());
+				w.tasks.pop_back();
+				return true;
+			}
 		}
-		else {
-			hints.ai_family = AF_UNSPEC;
+		for (std::size_t k {1}; k < _workers.size(); ++k) {
+			worker& v = *_workers[(self + k) % _workers.size()];
+			std::lock_guard<std::mutex> lock {v.m};
+			if (!v.tasks.empty()) {
+				t = std::move(v.tasks.front());
+				v.tasks.pop_front();
+				return true;
+			}
 		}
-		hints.ai_socktype = SOCK_DGRAM;
-		hints.ai_flags = AI_PASSIVE;
-		char port[6] = {0};
-		std::stringstream ss;
-		ss << _port;
-		ss >> port;
-		port[5] = 0;
-		int rv = getaddrinfo(NULL, port, &hints, &_addrinfos.infos);
-		if (rv != 0) {
-			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		return false;
+	}
+	void run_posted(worker& w) {
+		std::vector<task> posted;
+		{
+			std::lock_guard<std::mutex> lock {w.m};
+			posted.swap(w.posted);
 		}
-		for (_addrinfos.p = _addrinfos.infos; _addrinfos.p != NULL; _addrinfos.p = _addrinfos.p->ai_next) {
-			_socket_fd = socket(_addrinfos.p->ai_family, _addrinfos.p->ai_socktype, _addrinfos.p->ai_protocol);
-			if (_socket_fd == -1) {
-				// swallow error
-				continue;
-			}
-			if (bind(_socket_fd, _addrinfos.p->ai_addr, _addrinfos.p->ai_addrlen) == -1) {
-				close(_socket_fd);
-				// swallow error
+		for (task& t : posted) {
+			this->run_task(t);
+		}
+	}
+	void work(std::size_t index) {
+		current() = location {this, index};
+		worker& w = *_workers[index];
+		task t;
+		while (_running) {
+			this->run_posted(w);
+			this->serve_unfinished(w);
+			if (this->next_task(index, t)) {
+				this->run_task(t);
+				t = nullptr;
+				// keep connections served in between tasks
+				w.loop.run_once(std::chrono::milliseconds {0});
 				continue;
 			}
-			break;
+			w.loop.run_once(std::chrono::milliseconds {w.unfinished.empty() ? -1 : 0});
 		}
-		if (_addrinfos.p == NULL) {
-			freeaddrinfo(_addrinfos.infos);
+		current() = location {nullptr, npos};
+	}
+	std::vector<std::unique_ptr<worker>> _workers;
+	std::atomic<bool> _running;
+	std::atomic<std::size_t> _next;
+	std::atomic<std::size_t> _connections;
+	error_handler _on_error;
+};
+#ifdef INET_USE_IO_URING
+/**
+ * io_uring based transport for TCP
+ *
+ * accept, recv and send operations are only queued by the async_*
+ * functions and handed to the kernel in one batch by submit() or
+ * run_once(). sockets are used as fixed files if the kernel supports it.
+ * data is received into and sent from the inetstream's own buffers.
+ *
+ * handlers get the outcome of their operation as std::error_code, so a
+ * peer that reset its connection only concerns the owner of that
+ * connection, which is expected to close it.
+ *
+ * servers and inetstreams with operations in flight must neither be moved
+ * nor used otherwise until their handler ran, and have to be remove()-d
+ * before they are destroyed.
+ */
+class uring {
+public:
+	typedef std::function<void(std::error_code, inetstream<protocol::TCP>&&)> accept_handler;
+	typedef std::function<void(std::error_code, std::size_t)> completion_handler;
+	/**
+	 * @param entries size of the submission queue
+	 *
+	 * @throws std::system_error if the ring could not be set up
+	 */
+	explicit uring(unsigned entries = INET_URING_ENTRIES)
+		: _ring_fd {-1}, _sq_ptr {MAP_FAILED}, _cq_ptr {MAP_FAILED},
+		  _sqes {static_cast<io_uring_sqe*>(MAP_FAILED)}, _to_submit {0}, _enters {0}
+	{
+		io_uring_params p;
+		std::memset(&p, 0, sizeof p);
+		_ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+		if (_ring_fd == -1) {
 			throw std::system_error {errno, std::system_category(), strerror(errno)};
 		}
+		_sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		_cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+		if (single_mmap) {
+			_sq_sz = _cq_sz = std::max(_sq_sz, _cq_sz);
+		}
+		_sqes_sz = p.sq_entries * sizeof(io_uring_sqe);
+		_sq_ptr = mmap(nullptr, _sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		               _ring_fd, IORING_OFF_SQ_RING);
+		if (_sq_ptr != MAP_FAILED) {
+			_cq_ptr = single_mmap ? _sq_ptr :
+				mmap(nullptr, _cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				     _ring_fd, IORING_OFF_CQ_RING);
+		}
+		if (_cq_ptr != MAP_FAILED) {
+			_sqes = static_cast<io_uring_sqe*>(
+				mmap(nullptr, _sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				     _ring_fd, IORING_OFF_SQES));
+		}
+		if (_sqes == MAP_FAILED) {
+			int err = errno;
+			this->release();
+			throw std::system_error {err, std::system_category(), strerror(err)};
+		}
+		byte* sq = static_cast<byte*>(_sq_ptr);
+		_sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+		_sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+		_sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+		_sq_entries = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_entries);
+		_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+		_sq_local_tail = *_sq_tail;
+		byte* cq = static_cast<byte*>(_cq_ptr);
+		_cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+		_cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+		_cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+		_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+		// sparse fixed file table, filled on first use of a socket
+		std::vector<int> files(INET_URING_FILES, -1);
+		if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_FILES,
+		            files.data(), files.size()) == 0) {
+			for (std::size_t i {files.size()}; i > 0; --i) {
+				_free_slots.push_back(static_cast<int>(i - 1));
+			}
+		}
+		// otherwise plain file descriptors are used
 	}
-	~server() {
-		close(_socket_fd); _socket_fd = -1;
-		freeaddrinfo(_addrinfos.infos);
-		_addrinfos.infos = _addrinfos.p = nullptr;
+	uring(const uring&) = delete;
+	uring& operator=(const uring&) = delete;
+	~uring() {
+		this->release();
 	}
 	/**
-	 * set the underlying socket to non-blocking mode.
-	 * @throws std::system_error if an error occurs
+	 * queue accepting one client of s, on_accept receives the connection.
+	 * if accepting failed, the stream it gets is not connected.
 	 */
-	template <protocol T = P>
-	typename std::enable_if<is_tcp_prot<T>::value>::type set_nonblocking() {
-		if (fcntl(_socket_fd, F_SETFD, O_NONBLOCK)) {
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
-		}
+	void async_accept(server<protocol::TCP>& s, accept_handler on_accept) {
+		std::size_t idx = this->new_op();
+		op& o = _ops[idx];
+		o.k = op::kind::accept;
+		o.srv = &s;
+		o.on_accept = std::move(on_accept);
+		o.from.len = sizeof o.from.addr;
+		io_uring_sqe* sqe = this->prep(IORING_OP_ACCEPT, s._socket_fd, idx);
+		sqe->addr = reinterpret_cast<uint64_t>(&o.from.addr);
+		sqe->addr2 = reinterpret_cast<uint64_t>(&o.from.len);
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
 	}
 	/**
-	 * if using select() before set_nonblocking() has been called, the
-	 * behaviour is undefined.
-	 *
-	 * blocks while now() < time_of_call + timeout and checks if a client
-	 * can be accept()-ed without blocking.
-	 *
-	 * @param timeout duration for which to wait for client to connect()
+	 * queue receiving up to sz bytes into istr, on_done receives the
+	 * number of bytes received. zero bytes without an error mean remote hung
+	 * up.
+	 */
+	void async_recv(inetstream<protocol::TCP>& istr, std::size_t sz, completion_handler on_done) {
+		std::size_t idx = this->new_op();
+		op& o = _ops[idx];
+		o.k = op::kind::recv;
+		o.istr = &istr;
+		o.on_done = std::move(on_done);
+		istr.compact();
+		o.offset = istr._recv_buf.size();
+		istr._recv_buf.resize(o.offset + sz);
+		io_uring_sqe* sqe = this->prep(IORING_OP_RECV, istr._socket_fd, idx);
+		sqe->addr = reinterpret_cast<uint64_t>(&istr._recv_buf[o.offset]);
+		sqe->len = static_cast<uint32_t>(sz);
+	}
+	/**
+	 * queue sending everything pushed into istr, on_done receives the
+	 * number of bytes sent once all of them are. on error it receives how
+	 * many made it before and the data stays in istr.
 	 *
-	 * @return early true if client can be accept()-ed or false after
-	 * timeout expired otherwise
+	 * @throws std::runtime_error if istr holds buffers queued by write_ref()
+	 */
+	void async_send(inetstream<protocol::TCP>& istr, completion_handler on_done) {
+		if (!istr._segments.empty()) {
+			throw std::runtime_error {"async_send() does not support write_ref()"};
+		}
+		std::size_t idx = this->new_op();
+		op& o = _ops[idx];
+		o.k = op::kind::send;
+		o.istr = &istr;
+		o.on_done = std::move(on_done);
+		o.offset = 0;
+		o.total = istr._send_buf.size();
+		this->prep_send(idx);
+	}
+	/**
+	 * release the fixed file slot of s, required before s is destroyed
+	 */
+	void remove(server<protocol::TCP>& s) { this->release_slot(s._socket_fd); }
+	/**
+	 * release the fixed file slot of istr, required before istr is destroyed
+	 */
+	void remove(inetstream<protocol::TCP>& istr) { this->release_slot(istr._socket_fd); }
+	/**
+	 * hands all queued operations to the kernel without waiting
 	 *
-	 * @throws std::system_error if ::select() encounters an error
+	 * @return number of operations submitted
 	 *
+	 * @throws std::system_error if ::io_uring_enter() encounters an error
 	 */
-	template <protocol T = P>
-	typename std::enable_if<is_tcp_prot<T>::value, bool>::type
-	select(std::chrono::milliseconds timeout) const {
-		struct timeval t {};
-		t.tv_sec = timeout.count() / 1000;
-		t.tv_usec = (timeout.count() - t.tv_sec * 1000) * 1000;
-		fd_set rfds {};
-		FD_ZERO(&rfds);
-		FD_SET(_socket_fd, &rfds);
-		int rv = ::select(_socket_fd + 1, &rfds, nullptr, nullptr, &t);
-		if (rv == 0) {
-			return false;
-		}
-		if (rv > 0) {
-			return true;
-		}
-		throw std::system_error {errno, std::system_category(), strerror(errno)};
+	std::size_t submit() {
+		return this->enter(0, 0);
 	}
 	/**
-	 * blocks until a client connects.
+	 * submits all queued operations, waits for at least one of them to
+	 * complete and calls the handlers of all completed operations
 	 *
-	 * @throws std::system_error if ::accept() was interrupted by a signal
-	 * or the connection could not established cleanly
+	 * @param timeout duration for which to wait, negative waits forever
 	 *
-	 * @return inetstream to the connected client
+	 * @return number of completed operations
+	 *
+	 * @throws std::system_error if ::io_uring_enter() encounters an error.
+	 * if a handler throws, completions not yet dispatched are kept for the
+	 * next call.
 	 */
-	// enables "accept" if protocol is TCP
-	template <protocol T = P>
-	typename std::enable_if<is_tcp_prot<T>::value, inetstream<protocol::TCP>>::type accept() {
-		sockaddr_storage client_addr;
-		socklen_t sin_sz = sizeof client_addr;
-		int new_fd = ::accept(_socket_fd, reinterpret_cast<sockaddr*>(&client_addr), &sin_sz);
-		if (new_fd == -1) {
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
-		}
-		char s[INET6_ADDRSTRLEN];
-		const char* rv = inet_ntop(client_addr.ss_family,
-		                           get_in_addr(reinterpret_cast<sockaddr*>(&client_addr)),
-		                           s, sizeof s);
-		if (rv == NULL) {
-			close(new_fd);
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+	std::size_t run_once(std::chrono::milliseconds timeout) {
+		if (!this->completions_ready()) {
+			if (timeout.count() >= 0) {
+				// completes on timeout or as soon as one other operation did
+				_ts.tv_sec = timeout.count() / 1000;
+				_ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+				io_uring_sqe* sqe = this->prep(IORING_OP_TIMEOUT, -1, 0);
+				sqe->flags = 0;
+				sqe->addr = reinterpret_cast<uint64_t>(&_ts);
+				sqe->len = 1;
+				sqe->off = 1;
+			}
+			this->enter(1, IORING_ENTER_GETEVENTS);
 		}
-		if (fcntl(new_fd, F_SETFL, O_NONBLOCK) != 0) {
-			close(new_fd);
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		else if (_to_submit) {
+			this->enter(0, 0);
 		}
-		// connected to s
-		return inetstream<protocol::TCP> {new_fd, {nullptr, nullptr}, /*owns*/true};
+		return this->reap();
 	}
 	/**
-	 *
-	 * @return inetstream to this end of the communication
+	 * @return number of operations in flight or queued
 	 */
-	// enables "get_inetstream" if protocol is UDP
-	template <protocol T = P>
-	typename std::enable_if<is_udp_prot<T>::value, inetstream<protocol::UDP>>::type
-	get_inetstream() {
-		// don't transfer ownership
-		return inetstream<protocol::UDP> {_socket_fd, _addrinfos, /*owns*/false};
-	}
-private:
-	unsigned short _port;
-	int _socket_fd;
-	addrinfos _addrinfos;
-};
-
-template <protocol P>
-class client {
-public:
-	template <protocol T = P, typename std::enable_if<is_tcp_prot<T>::value, int>::type* = nullptr>
-	client(const std::string& Host, unsigned short Port)
-		: _host {Host}, _port {Port} {}
-	template <protocol T = P, typename std::enable_if<is_udp_prot<T>::value, int>::type* = nullptr>
-	client (const std::string& Host, unsigned short Port)
-		: _host {Host}, _port {Port} {}
+	std::size_t pending() const { return _ops.size() - _free_ops.size(); }
 	/**
-	 * connect the client to the server specified via the constructor
-	 *
-	 * @throws std::system_error if connection was not possible for some
-	 * reason
-	 *
-	 * @return inetstream to the connected server
+	 * @return number of ::io_uring_enter() calls made so far
 	 */
-	// enables "connect" if protocol is TCP
-	template <protocol T = P>
-	typename std::enable_if<is_tcp_prot<T>::value, inetstream<protocol::TCP>>::type
-	connect() {
-		addrinfo hints;
-		std::memset(&hints, 0, sizeof hints);
-		if (INET_IPV == 4) {
-			hints.ai_family = AF_INET;
+	std::size_t enters() const { return _enters; }
+private:
+	struct op {
+		enum class kind { accept, recv, send } k;
+		server<protocol::TCP>* srv;
+		inetstream<protocol::TCP>* istr;
+		accept_handler on_accept;
+		completion_handler on_done;
+		// recv: size of the receive buffer before, send: bytes sent already
+		std::size_t offset;
+		std::size_t total;
+		// accept: address of the client
+		endpoint from;
+	};
+	std::size_t new_op() {
+		if (!_free_ops.empty()) {
+			std::size_t idx = _free_ops.back();
+			_free_ops.pop_back();
+			return idx;
 		}
-		else if (INET_IPV == 6) {
-			hints.ai_family = AF_INET6;
+		// deque keeps addresses of ops in flight stable
+		_ops.emplace_back();
+		return _ops.size() - 1;
+	}
+	void free_op(std::size_t idx) {
+		_ops[idx].on_accept = nullptr;
+		_ops[idx].on_done = nullptr;
+		_free_ops.push_back(idx);
+	}
+	io_uring_sqe* prep(uint8_t opcode, int fd, std::size_t idx) {
+		if (_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _sq_entries) {
+			// submission queue full, make room
+			this->submit();
 		}
-		else {
-			hints.ai_family = AF_UNSPEC;
+		unsigned i = _sq_local_tail & _sq_mask;
+		io_uring_sqe* sqe = &_sqes[i];
+		std::memset(sqe, 0, sizeof *sqe);
+		sqe->opcode = opcode;
+		sqe->fd = this->file_index(fd, sqe->flags);
+		// 0 is reserved for timeouts
+		sqe->user_data = fd == -1 ? 0 : idx + 1;
+		_sq_array[i] = i;
+		++_sq_local_tail;
+		++_to_submit;
+		return sqe;
+	}
+	void prep_send(std::size_t idx) {
+		op& o = _ops[idx];
+		io_uring_sqe* sqe = this->prep(IORING_OP_SEND, o.istr->_socket_fd, idx);
+		sqe->addr = reinterpret_cast<uint64_t>(o.istr->_send_buf.data() + o.offset);
+		sqe->len = static_cast<uint32_t>(o.total - o.offset);
+	}
+	int file_index(int fd, uint8_t& flags) {
+		if (fd == -1) {
+			return fd;
 		}
-		hints.ai_socktype = SOCK_STREAM;
-		char port[6] = {0};
-		std::stringstream ss;
-		ss << _port;
-		ss >> port;
-		port[5] = 0;
-		addrinfo* infos, *p;
-		int rv = getaddrinfo(_host.c_str(), port, &hints, &infos);
-		if (rv != 0) {
-			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		auto it = _slots.find(fd);
+		if (it != _slots.end()) {
+			flags |= IOSQE_FIXED_FILE;
+			return it->second;
 		}
-		for (p = infos; p != NULL; p = p->ai_next) {
-			_socket_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-			if (_socket_fd == -1) {
-				// swallow error
-				continue;
+		if (_free_slots.empty()) {
+			return fd;
+		}
+		int slot = _free_slots.back();
+		io_uring_files_update upd;
+		std::memset(&upd, 0, sizeof upd);
+		upd.offset = static_cast<uint32_t>(slot);
+		upd.fds = reinterpret_cast<uint64_t>(&fd);
+		if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_FILES_UPDATE, &upd, 1) != 1) {
+			return fd;
+		}
+		_free_slots.pop_back();
+		_slots[fd] = slot;
+		flags |= IOSQE_FIXED_FILE;
+		return slot;
+	}
+	void release_slot(int fd) {
+		auto it = _slots.find(fd);
+		if (it == _slots.end()) {
+			return;
+		}
+		int none = -1;
+		io_uring_files_update upd;
+		std::memset(&upd, 0, sizeof upd);
+		upd.offset = static_cast<uint32_t>(it->second);
+		upd.fds = reinterpret_cast<uint64_t>(&none);
+		syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_FILES_UPDATE, &upd, 1);
+		_free_slots.push_back(it->second);
+		_slots.erase(it);
+	}
+	std::size_t enter(unsigned min_complete, unsigned flags) {
+		__atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+		++_enters;
+		int rv = static_cast<int>(syscall(__NR_io_uring_enter, _ring_fd, _to_submit,
+		                                  min_complete, flags, nullptr, 0));
+		if (rv == -1) {
+			if (errno == EINTR) {
+				// a signal arrived before anything was submitted
+				return 0;
 			}
-			if (::connect(_socket_fd, p->ai_addr, p->ai_addrlen) == -1) {
-				close(_socket_fd);
-				// swallow error
+			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		}
+		_to_submit -= static_cast<unsigned>(rv);
+		return static_cast<std::size_t>(rv);
+	}
+	bool completions_ready() const {
+		return *_cq_head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+	}
+	std::size_t reap() {
+		std::size_t n {0};
+		unsigned head = *_cq_head;
+		while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+			io_uring_cqe cqe = _cqes[head & _cq_mask];
+			__atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+			if (cqe.user_data == 0) {
 				continue;
 			}
-			break;
+			++n;
+			this->complete(static_cast<std::size_t>(cqe.user_data - 1), cqe.res);
 		}
-		if (p == NULL) {
-			freeaddrinfo(infos);
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		return n;
+	}
+	void complete(std::size_t idx, int res) {
+		op& o = _ops[idx];
+		std::error_code ec;
+		if (res < 0) {
+			ec = std::error_code {-res, std::system_category()};
 		}
-		char s[INET6_ADDRSTRLEN];
-		const char* rvp = inet_ntop(
-			p->ai_family,
-			get_in_addr(reinterpret_cast<sockaddr*>(p->ai_addr)),
-			s, sizeof s);
-		if (rvp == NULL) {
-			freeaddrinfo(infos);
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		if (o.k == op::kind::accept) {
+			accept_handler h = std::move(o.on_accept);
+			server<protocol::TCP>* srv = o.srv;
+			endpoint from = o.from;
+			this->free_op(idx);
+			if (ec) {
+				h(ec, inetstream<protocol::TCP> {-1, {nullptr, nullptr}, /*owns*/false});
+				return;
+			}
+			h(ec, srv->make_stream(res, from));
+			return;
 		}
-		if (fcntl(_socket_fd, F_SETFL, O_NONBLOCK) != 0) {
-			freeaddrinfo(infos);
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		inetstream<protocol::TCP>& istr = *o.istr;
+		if (o.k == op::kind::recv) {
+			istr._recv_buf.resize(o.offset + (res > 0 ? res : 0));
+			completion_handler h = std::move(o.on_done);
+			this->free_op(idx);
+			if (res == 0) {
+				istr._eof = true;
+			}
+			h(ec, static_cast<std::size_t>(res > 0 ? res : 0));
+			return;
 		}
-		return inetstream<protocol::TCP> {_socket_fd, addrinfos {infos, p}, /*owns*/true};
-	}
-	/**
-	 * @throws std::system_error if communication could not be established
-	 * @return inetstream to this end of the communication
-	 */
-	// enables "get_inetstream" if protocol is UDP
-	template <protocol T = P>
-	typename std::enable_if<is_udp_prot<T>::value, inetstream<protocol::UDP>>::type
-	get_inetstream() {
-		addrinfo hints;
-		std::memset(&hints, 0, sizeof hints);
-		if (INET_IPV == 4) {
-			hints.ai_family = AF_INET;
+		if (ec) {
+			completion_handler h = std::move(o.on_done);
+			std::size_t sent = o.offset;
+			this->free_op(idx);
+			h(ec, sent);
+			return;
 		}
-		else if (INET_IPV == 6) {
-			hints.ai_family = AF_INET6;
+		o.offset += static_cast<std::size_t>(res);
+		if (o.offset < o.total) {
+			// short send, queue the rest
+			this->prep_send(idx);
+			return;
 		}
-		else {
-			hints.ai_family = AF_UNSPEC;
+		istr.clear_send();
+		completion_handler h = std::move(o.on_done);
+		std::size_t total = o.total;
+		this->free_op(idx);
+		h(ec, total);
+	}
+	void release() {
+		if (_sqes != MAP_FAILED) {
+			munmap(_sqes, _sqes_sz);
 		}
-		hints.ai_socktype = SOCK_DGRAM;
-		char port[6] = {0};
-		std::stringstream ss;
-		ss << _port;
-		ss >> port;
-		port[5] = 0;
-		addrinfo* infos, *p;
-		int rv = getaddrinfo(_host.c_str(), port, &hints, &infos);
-		if (rv != 0) {
-			throw std::system_error {rv, std::system_category(), gai_strerror(rv)};
+		if (_cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr) {
+			munmap(_cq_ptr, _cq_sz);
 		}
-		for (p = infos; p != NULL; p = p->ai_next) {
-			_socket_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-			if (_socket_fd == -1) {
-				// swallow error
-				continue;
-			}
-			break;
+		if (_sq_ptr != MAP_FAILED) {
+			munmap(_sq_ptr, _sq_sz);
 		}
-		if (p == NULL) {
-			freeaddrinfo(infos);
-			throw std::system_error {errno, std::system_category(), strerror(errno)};
+		if (_ring_fd != -1) {
+			close(_ring_fd);
 		}
-		return inetstream<protocol::UDP> {_socket_fd, addrinfos {infos, p}, /*owns*/true};
 	}
-private:
-	std::string _host;
-	unsigned short _port;
-	int _socket_fd;
+	int _ring_fd;
+	void* _sq_ptr;
+	void* _cq_ptr;
+	io_uring_sqe* _sqes;
+	std::size_t _sq_sz, _cq_sz, _sqes_sz;
+	unsigned* _sq_head;
+	unsigned* _sq_tail;
+	unsigned* _sq_array;
+	unsigned _sq_mask, _sq_entries, _sq_local_tail;
+	unsigned* _cq_head;
+	unsigned* _cq_tail;
+	io_uring_cqe* _cqes;
+	unsigned _cq_mask;
+	unsigned _to_submit;
+	std::size_t _enters;
+	__kernel_timespec _ts;
+	std::deque<op> _ops;
+	std::vector<std::size_t> _free_ops;
+	std::unordered_map<int, int> _slots;
+	std::vector<int> _free_slots;
 };
+#endif
 } // namespace inet
 #endif
@@ -0,0 +1,280 @@
+#ifndef INETSTREAM_CORO_HPP_
+#define INETSTREAM_CORO_HPP_
+/*
+ * C++20 coroutine interface on top of inet::event_loop, opt-in: include
+ * this header instead of inetstream.hpp and compile with -std=c++20.
+ *
+ *     inet::co_task session(inet::event_loop& loop, inet::inetstream<inet::protocol::TCP> istr) {
+ *         inet::async_stream s {loop, std::move(istr)};
+ *         while (co_await s.async_recv(4) == 4) {
+ *             int i;
+ *             *s >> i;
+ *             *s << i + 1;
+ *             co_await s.async_send();
+ *         }
+ *     }
+ *
+ * a suspended session costs its coroutine frame and stream, no thread.
+ */
+#include "inetstream.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+
+namespace inet {
+
+/**
+ * coroutine that starts right away and cleans up after itself. nobody
+ * waits for it, so an exception thrown out of it goes to the handler set
+ * with set_error_handler() on the thread it runs on and ends it. without
+ * a handler it calls std::terminate().
+ */
+struct co_task {
+	typedef std::function<void(std::exception_ptr)> error_handler;
+	/**
+	 * sets the handler of the calling thread, i.e. for the co_tasks started
+	 * on it and resumed by the event_loop it runs
+	 */
+	static void set_error_handler(error_handler h) {
+		handler() = std::move(h);
+	}
+	struct promise_type {
+		co_task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() {
+			if (!handler()) {
+				std::terminate();
+			}
+			handler()(std::current_exception());
+		}
+	};
+private:
+	static error_handler& handler() {
+		static thread_local error_handler h;
+		return h;
+	}
+};
+
+/**
+ * inetstream driven by an event_loop. async_recv() and async_send()
+ * suspend the calling coroutine until the socket is ready and resume it
+ * from event_loop::run_once().
+ *
+ * registers itself with the loop, so it can be neither copied nor moved.
+ * only one receive and one send may be pending at a time.
+ */
+class async_stream {
+public:
+	typedef inetstream<protocol::TCP> stream;
+	/**
+	 * @throws std::system_error if the stream could not be registered
+	 */
+	async_stream(event_loop& loop, stream&& istr)
+		: _loop {loop}, _istr {std::move(istr)}, _recv_target {0}, _sent {0}, _send_errno {0} {
+		if (!_istr._segments.empty()) {
+			throw std::runtime_error {"async_stream does not support write_ref()"};
+		}
+		_loop.add(_istr, [this](stream&) { this->on_readable(); },
+		          [this](stream&) { this->on_writable(); });
+	}
+	async_stream(const async_stream&) = delete;
+	async_stream& operator=(const async_stream&) = delete;
+	~async_stream() {
+		_loop.remove(_istr);
+	}
+	stream& operator*() { return _istr; }
+	stream* operator->() { return &_istr; }
+
+	struct recv_awaiter {
+		async_stream& s;
+		std::size_t n;
+		bool await_ready() {
+			return s.try_recv(n);
+		}
+		void await_suspend(std::coroutine_handle<> h) {
+			s._reader = h;
+			s._recv_target = n;
+		}
+		/**
+		 * @return bytes available to read, less than n only if remote hung
+		 * up
+		 */
+		std::size_t await_resume() {
+			if (s._recv_error) {
+				std::exception_ptr e = s._recv_error;
+				s._recv_error = nullptr;
+				std::rethrow_exception(e);
+			}
+			return std::min(s._istr.size(), n);
+		}
+	};
+	/**
+	 * waits until at least n bytes can be read from the stream
+	 *
+	 * @throws std::system_error if ::recv() encountered an error
+	 */
+	recv_awaiter async_recv(std::size_t n) {
+		return recv_awaiter {*this, n};
+	}
+
+	struct send_awaiter {
+		async_stream& s;
+		bool await_ready() {
+			return s.try_send();
+		}
+		void await_suspend(std::coroutine_handle<> h) {
+			s._writer = h;
+		}
+		/**
+		 * @return number of bytes sent
+		 *
+		 * @throws std::system_error if ::send() encountered an error
+		 */
+		std::size_t await_resume() {
+			std::size_t sent = s._sent;
+			s._sent = 0;
+			if (s._send_errno != 0) {
+				int err = s._send_errno;
+				s._send_errno = 0;
+				s._istr.clear_send();
+				throw std::system_error {err, std::system_category(), strerror(err)};
+			}
+			s._istr.clear_send();
+			return sent;
+		}
+	};
+	/**
+	 * waits until everything pushed onto the stream has been sent
+	 */
+	send_awaiter async_send() {
+		return send_awaiter {*this};
+	}
+private:
+	/**
+	 * receives what is there without waiting
+	 *
+	 * @return true once n bytes can be read or remote hung up
+	 */
+	bool try_recv(std::size_t n) {
+		if (_istr.size() < n && !_istr.eof()) {
+			_istr.recv(n - _istr.size(), std::chrono::milliseconds {0});
+		}
+		return _istr.size() >= n || _istr.eof();
+	}
+	/**
+	 * sends what the socket takes without waiting
+	 *
+	 * @return true once everything is sent or sending failed
+	 */
+	bool try_send() {
+		buffer& buf = _istr._send_buf;
+		while (_sent < buf.size()) {
+			ssize_t rv = ::send(_istr._socket_fd, buf.data() + _sent, buf.size() - _sent, MSG_NOSIGNAL);
+			if (rv == -1) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return false;
+				}
+				if (errno == EINTR) {
+					continue;
+				}
+				_send_errno = errno;
+				return true;
+			}
+			_sent += static_cast<std::size_t>(rv);
+		}
+		return true;
+	}
+	void on_readable() {
+		if (!_reader) {
+			// left in the socket for the next async_recv()
+			return;
+		}
+		try {
+			if (!this->try_recv(_recv_target)) {
+				return;
+			}
+		}
+		catch (const std::system_error&) {
+			_recv_error = std::current_exception();
+		}
+		std::coroutine_handle<> h = _reader;
+		_reader = nullptr;
+		h.resume();
+	}
+	void on_writable() {
+		if (_writer && this->try_send()) {
+			std::coroutine_handle<> h = _writer;
+			_writer = nullptr;
+			h.resume();
+		}
+	}
+	event_loop& _loop;
+	stream _istr;
+	std::coroutine_handle<> _reader;
+	std::coroutine_handle<> _writer;
+	std::size_t _recv_target;
+	std::exception_ptr _recv_error;
+	// bytes of the send buffer sent so far
+	std::size_t _sent;
+	int _send_errno;
+};
+
+/**
+ * server accepting clients for coroutines through an event_loop, see
+ * async_stream. puts the server into non-blocking mode.
+ */
+class async_server {
+public:
+	typedef inetstream<protocol::TCP> stream;
+	/**
+	 * @throws std::system_error if the server could not be registered
+	 */
+	async_server(event_loop& loop, server<protocol::TCP>& srv) : _loop {loop}, _srv {srv} {
+		_loop.add(_srv, [this](stream&& istr) { this->on_accept(std::move(istr)); });
+	}
+	async_server(const async_server&) = delete;
+	async_server& operator=(const async_server&) = delete;
+	~async_server() {
+		_loop.remove(_srv);
+	}
+	struct accept_awaiter {
+		async_server& s;
+		bool await_ready() {
+			return !s._accepted.empty();
+		}
+		void await_suspend(std::coroutine_handle<> h) {
+			s._acceptor = h;
+		}
+		stream await_resume() {
+			stream istr {std::move(s._accepted.front())};
+			s._accepted.pop_front();
+			return istr;
+		}
+	};
+	/**
+	 * waits for the next client to connect
+	 */
+	accept_awaiter async_accept() {
+		return accept_awaiter {*this};
+	}
+private:
+	void on_accept(stream&& istr) {
+		_accepted.push_back(std::move(istr));
+		if (_acceptor) {
+			std::coroutine_handle<> h = _acceptor;
+			_acceptor = nullptr;
+			h.resume();
+		}
+	}
+	event_loop& _loop;
+	server<protocol::TCP>& _srv;
+	// clients accepted before anyone asked for them
+	std::deque<stream> _accepted;
+	std::coroutine_handle<> _acceptor;
+};
+
+} // namespace inet
+#endif
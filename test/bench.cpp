@@ -0,0 +1,621 @@
+// micro benchmarks, build with `make bench` and run `bin/bench [name...]`
+#define INET_USE_IO_URING
+#include "../inetstream.hpp"
+
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <atomic>
+
+// the Makefile links the bench with --wrap for the syscalls of the epoll
+// path, so they can be counted on the thread under test
+namespace {
+thread_local bool count_syscalls {false};
+std::atomic<std::size_t> syscalls {0};
+void counted() {
+	if (count_syscalls) {
+		++syscalls;
+	}
+}
+}
+extern "C" {
+ssize_t __real_recv(int, void*, size_t, int);
+ssize_t __real_sendmsg(int, const msghdr*, int);
+int __real_epoll_wait(int, epoll_event*, int, int);
+int __real_ppoll(pollfd*, nfds_t, const timespec*, const sigset_t*);
+ssize_t __wrap_recv(int fd, void* buf, size_t len, int flags) {
+	counted();
+	return __real_recv(fd, buf, len, flags);
+}
+ssize_t __wrap_sendmsg(int fd, const msghdr* msg, int flags) {
+	counted();
+	return __real_sendmsg(fd, msg, flags);
+}
+int __wrap_epoll_wait(int epfd, epoll_event* events, int maxevents, int timeout) {
+	counted();
+	return __real_epoll_wait(epfd, events, maxevents, timeout);
+}
+int __wrap_ppoll(pollfd* fds, nfds_t nfds, const timespec* ts, const sigset_t* mask) {
+	counted();
+	return __real_ppoll(fds, nfds, ts, mask);
+}
+}
+
+namespace {
+typedef std::chrono::steady_clock bench_clock;
+
+double seconds_since(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+void report(const char* name, double value, const char* unit) {
+	std::printf("%-44s %14.0f %s\n", name, value, unit);
+}
+void report_ratio(const char* name, double value, const char* unit) {
+	std::printf("%-44s %14.2f %s\n", name, value, unit);
+}
+
+constexpr int ECHO_CONNECTIONS {4};
+constexpr int ECHO_ROUNDS {1000};
+constexpr std::size_t ECHO_MSG_SZ {64};
+
+// every client sends ECHO_ROUNDS messages and waits for each echo
+std::vector<std::thread> echo_clients(unsigned short port) {
+	std::vector<std::thread> clients;
+	for (int c {0}; c < ECHO_CONNECTIONS; ++c) {
+		clients.emplace_back([port] {
+			std::this_thread::sleep_for(std::chrono::milliseconds{10});
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", port};
+			auto istr = client.connect();
+			for (int r {0}; r < ECHO_ROUNDS; ++r) {
+				for (std::size_t i {0}; i < ECHO_MSG_SZ; ++i) {
+					istr << static_cast<inet::byte>(i);
+				}
+				istr.send();
+				std::size_t got {0};
+				while (got < ECHO_MSG_SZ) {
+					got += istr.recv(ECHO_MSG_SZ - got);
+				}
+				istr.clear();
+			}
+		});
+	}
+	return clients;
+}
+
+void bench_echo_threads() {
+	constexpr unsigned short port {4000};
+	inet::server<inet::protocol::TCP> server {port};
+	auto clients = echo_clients(port);
+	std::vector<std::thread> handlers;
+	auto start = bench_clock::now();
+	for (int c {0}; c < ECHO_CONNECTIONS; ++c) {
+		auto istr = server.accept();
+		handlers.emplace_back([](inet::inetstream<inet::protocol::TCP> s) {
+			for (int r {0}; r < ECHO_ROUNDS; ++r) {
+				std::size_t got {0};
+				while (got < ECHO_MSG_SZ) {
+					got += s.recv(ECHO_MSG_SZ - got);
+				}
+				inet::byte b;
+				for (std::size_t i {0}; i < ECHO_MSG_SZ; ++i) {
+					s >> b;
+					s << b;
+				}
+				s.send();
+			}
+		}, std::move(istr));
+	}
+	for (auto& t : handlers) {
+		t.join();
+	}
+	for (auto& t : clients) {
+		t.join();
+	}
+	report("echo, thread per connection", ECHO_CONNECTIONS * ECHO_ROUNDS / seconds_since(start), "msgs/s");
+}
+
+void bench_echo_uring() {
+	constexpr unsigned short port {4001};
+	typedef inet::inetstream<inet::protocol::TCP> stream;
+	inet::server<inet::protocol::TCP> server {port};
+	auto clients = echo_clients(port);
+	inet::uring ring;
+	struct conn {
+		std::unique_ptr<stream> istr;
+		int rounds;
+	};
+	std::vector<conn> conns;
+	conns.reserve(ECHO_CONNECTIONS);
+	int finished {0};
+	std::function<void(conn&)> on_recv = [&](conn& c) {
+		if (c.istr->size() < ECHO_MSG_SZ) {
+			ring.async_recv(*c.istr, ECHO_MSG_SZ - c.istr->size(), [&](std::error_code ec, std::size_t) {
+				if (ec) {
+					throw std::system_error {ec};
+				}
+				on_recv(c);
+			});
+			return;
+		}
+		inet::byte b;
+		for (std::size_t i {0}; i < ECHO_MSG_SZ; ++i) {
+			*c.istr >> b;
+			*c.istr << b;
+		}
+		ring.async_send(*c.istr, [&](std::error_code ec, std::size_t) {
+			if (ec) {
+				throw std::system_error {ec};
+			}
+			if (++c.rounds == ECHO_ROUNDS) {
+				++finished;
+				return;
+			}
+			on_recv(c);
+		});
+	};
+	std::function<void(std::error_code, stream&&)> on_accept = [&](std::error_code ec, stream&& istr) {
+		if (ec) {
+			throw std::system_error {ec};
+		}
+		conns.push_back(conn {std::unique_ptr<stream> {new stream {std::move(istr)}}, 0});
+		on_recv(conns.back());
+		if (conns.size() < ECHO_CONNECTIONS) {
+			ring.async_accept(server, on_accept);
+		}
+	};
+	ring.async_accept(server, on_accept);
+	auto start = bench_clock::now();
+	std::size_t enters_before = ring.enters();
+	while (finished < ECHO_CONNECTIONS) {
+		ring.run_once(std::chrono::milliseconds {-1});
+	}
+	double secs = seconds_since(start);
+	double enters = static_cast<double>(ring.enters() - enters_before);
+	for (auto& c : conns) {
+		ring.remove(*c.istr);
+	}
+	ring.remove(server);
+	for (auto& t : clients) {
+		t.join();
+	}
+	report("echo, io_uring single thread", ECHO_CONNECTIONS * ECHO_ROUNDS / secs, "msgs/s");
+	report_ratio("echo, io_uring single thread", enters / (ECHO_CONNECTIONS * ECHO_ROUNDS), "syscalls/msg");
+}
+
+void bench_echo_epoll() {
+	constexpr unsigned short port {4023};
+	typedef inet::inetstream<inet::protocol::TCP> stream;
+	inet::server<inet::protocol::TCP> server {port};
+	auto clients = echo_clients(port);
+	inet::event_loop loop;
+	struct conn {
+		std::unique_ptr<stream> istr;
+		int rounds;
+	};
+	std::vector<conn> conns;
+	conns.reserve(ECHO_CONNECTIONS);
+	int finished {0};
+	loop.add(server, [&](stream&& istr) {
+		conns.push_back(conn {std::unique_ptr<stream> {new stream {std::move(istr)}}, 0});
+		conn& c = conns.back();
+		loop.add(*c.istr, [&](stream& s) {
+			// edge-triggered, read until the socket is drained
+			while (s.recv(ECHO_MSG_SZ, std::chrono::milliseconds {0}) == ECHO_MSG_SZ) {}
+			inet::byte b;
+			while (s.size() >= ECHO_MSG_SZ) {
+				for (std::size_t i {0}; i < ECHO_MSG_SZ; ++i) {
+					s >> b;
+					s << b;
+				}
+				s.send();
+				if (++c.rounds == ECHO_ROUNDS) {
+					++finished;
+				}
+			}
+		});
+	});
+	count_syscalls = true;
+	syscalls = 0;
+	auto start = bench_clock::now();
+	while (finished < ECHO_CONNECTIONS) {
+		loop.run_once(std::chrono::milliseconds {-1});
+	}
+	double secs = seconds_since(start);
+	count_syscalls = false;
+	double calls = static_cast<double>(syscalls);
+	for (auto& c : conns) {
+		loop.remove(*c.istr);
+	}
+	loop.remove(server);
+	for (auto& t : clients) {
+		t.join();
+	}
+	report("echo, epoll single thread", ECHO_CONNECTIONS * ECHO_ROUNDS / secs, "msgs/s");
+	report_ratio("echo, epoll single thread", calls / (ECHO_CONNECTIONS * ECHO_ROUNDS), "syscalls/msg");
+}
+
+void bench_echo_runtime() {
+	constexpr unsigned short port {4022};
+	inet::runtime rt;
+	rt.listen(port, [](inet::inetstream<inet::protocol::TCP>& s) {
+		inet::byte b;
+		while (s.size() >= ECHO_MSG_SZ) {
+			for (std::size_t i {0}; i < ECHO_MSG_SZ; ++i) {
+				s >> b;
+				s << b;
+			}
+		}
+		s.send();
+	});
+	rt.start();
+	auto start = bench_clock::now();
+	auto clients = echo_clients(port);
+	for (auto& t : clients) {
+		t.join();
+	}
+	report("echo, thread per core runtime", ECHO_CONNECTIONS * ECHO_ROUNDS / seconds_since(start), "msgs/s");
+}
+
+// a connected pair, serialization benchmarks never actually send
+struct stream_pair {
+	explicit stream_pair(unsigned short port) : server {port} {
+		std::thread t {[this, port] {
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", port};
+			remote.reset(new inet::inetstream<inet::protocol::TCP> {client.connect()});
+		}};
+		local.reset(new inet::inetstream<inet::protocol::TCP> {server.accept()});
+		t.join();
+	}
+	inet::server<inet::protocol::TCP> server;
+	std::unique_ptr<inet::inetstream<inet::protocol::TCP>> local;
+	std::unique_ptr<inet::inetstream<inet::protocol::TCP>> remote;
+};
+
+constexpr std::size_t SERIALIZE_MSG_SZ {64 * 1024};
+constexpr int SERIALIZE_ROUNDS {2000};
+
+// serializes SERIALIZE_ROUNDS messages of SERIALIZE_MSG_SZ bytes each
+template <typename T>
+void bench_serialize(const char* name, unsigned short port, const T& value) {
+	stream_pair p {port};
+	auto& istr = *p.local;
+	istr.reserve(SERIALIZE_MSG_SZ);
+	const std::size_t per_msg = SERIALIZE_MSG_SZ / sizeof(T);
+	auto start = bench_clock::now();
+	for (int r {0}; r < SERIALIZE_ROUNDS; ++r) {
+		for (std::size_t i {0}; i < per_msg; ++i) {
+			istr << value;
+		}
+		istr.clear();
+	}
+	report(name, per_msg * sizeof(T) * SERIALIZE_ROUNDS / seconds_since(start), "bytes/s");
+}
+
+struct pod {
+	double x, y, z;
+	int32_t id;
+	int32_t flags;
+};
+
+void bench_serialize_ints() {
+	bench_serialize("serialize uint32_t", 4002, static_cast<uint32_t>(0x01020304));
+	bench_serialize("serialize uint64_t", 4003, static_cast<uint64_t>(0x0102030405060708));
+}
+void bench_serialize_strings() {
+	stream_pair p {4004};
+	auto& istr = *p.local;
+	istr.reserve(SERIALIZE_MSG_SZ);
+	const std::string s(64, 'x');
+	const std::size_t per_msg = SERIALIZE_MSG_SZ / s.size();
+	auto start = bench_clock::now();
+	for (int r {0}; r < SERIALIZE_ROUNDS; ++r) {
+		for (std::size_t i {0}; i < per_msg; ++i) {
+			istr << s;
+		}
+		istr.clear();
+	}
+	report("serialize std::string (64 bytes)", per_msg * s.size() * SERIALIZE_ROUNDS / seconds_since(start), "bytes/s");
+}
+void bench_serialize_pods() {
+	bench_serialize("serialize pod (32 bytes)", 4005, pod {1.0, 2.0, 3.0, 4, 5});
+}
+
+constexpr std::size_t ARRAY_ELEMS {10000};
+
+template <typename T>
+void bench_array(const char* name, unsigned short port) {
+	stream_pair p {port};
+	auto& istr = *p.local;
+	std::vector<T> v(ARRAY_ELEMS, static_cast<T>(42));
+	istr.reserve(ARRAY_ELEMS * sizeof(T));
+	auto start = bench_clock::now();
+	for (int r {0}; r < SERIALIZE_ROUNDS; ++r) {
+		istr << v;
+		istr.clear();
+	}
+	report(name, ARRAY_ELEMS * sizeof(T) * SERIALIZE_ROUNDS / seconds_since(start), "bytes/s");
+}
+void bench_serialize_arrays() {
+	bench_array<uint32_t>("serialize std::vector<uint32_t>", 4006);
+	bench_array<double>("serialize std::vector<double>", 4007);
+}
+
+constexpr std::size_t UDP_DATAGRAMS {200000};
+constexpr std::size_t UDP_DATAGRAM_SZ {64};
+
+// one thread sends UDP_DATAGRAMS datagrams, the other receives until the
+// sender is done and nothing arrives anymore, both batch at most batch
+// datagrams per syscall
+void bench_udp(const char* name, unsigned short port, std::size_t batch) {
+	inet::server<inet::protocol::UDP> server {port};
+	auto rx = server.get_inetstream();
+	rx.set_read_size(2048);
+	std::thread sender {[port, batch] {
+		inet::client<inet::protocol::UDP> client {"127.0.0.1", port};
+		auto tx = client.get_inetstream();
+		std::vector<inet::byte> payload(UDP_DATAGRAM_SZ, 42);
+		for (std::size_t sent {0}; sent < UDP_DATAGRAMS; sent += batch) {
+			for (std::size_t i {0}; i < batch; ++i) {
+				tx << payload;
+				tx.queue_datagram();
+			}
+			tx.send_batch();
+		}
+	}};
+	std::size_t got {0};
+	auto start = bench_clock::now(), last = start;
+	while (std::size_t n = rx.recv_batch(batch, std::chrono::milliseconds {200})) {
+		got += n;
+		last = bench_clock::now();
+		while (rx.next_datagram()) {
+		}
+	}
+	sender.join();
+	report(name, got / std::chrono::duration<double>(last - start).count(), "datagrams/s");
+}
+void bench_udp_batch() {
+	bench_udp("udp loopback, batches of 1", 4008, 1);
+	bench_udp("udp loopback, batches of 8", 4009, 8);
+	bench_udp("udp loopback, batches of 32", 4010, 32);
+	bench_udp("udp loopback, batches of 64", 4011, 64);
+}
+
+constexpr std::size_t BULK_CHUNK {1024 * 1024};
+constexpr std::size_t BULK_TOTAL {512 * BULK_CHUNK};
+
+double thread_cpu_seconds() {
+	timespec ts {};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+// sends BULK_TOTAL bytes in chunks referenced from one buffer and reports
+// the cpu time the sending thread spent per GB
+void bench_bulk(const char* name, unsigned short port, bool zerocopy) {
+	stream_pair p {port};
+	auto& tx = *p.local;
+	auto& rx = *p.remote;
+	rx.set_read_size(BULK_CHUNK);
+	if (zerocopy) {
+		tx.set_zerocopy(true);
+	}
+	std::thread receiver {[&rx] {
+		std::size_t got {0};
+		while (got < BULK_TOTAL) {
+			got += rx.recv(BULK_TOTAL - got);
+			rx.clear_recv();
+		}
+	}};
+	auto chunk = std::make_shared<std::vector<inet::byte>>(BULK_CHUNK, 42);
+	double cpu_start = thread_cpu_seconds();
+	for (std::size_t sent {0}; sent < BULK_TOTAL; sent += BULK_CHUNK) {
+		tx.write_ref(chunk);
+		tx.send();
+	}
+	tx.flush_zerocopy(std::chrono::milliseconds {1000});
+	double cpu = thread_cpu_seconds() - cpu_start;
+	receiver.join();
+	report(name, cpu * 1000 / (BULK_TOTAL / 1e9), "cpu ms/GB");
+}
+void bench_bulk_send() {
+	bench_bulk("bulk send, copied", 4012, false);
+	bench_bulk("bulk send, MSG_ZEROCOPY", 4013, true);
+}
+
+constexpr std::size_t STRING_SZ {1024};
+constexpr std::size_t STRING_COUNT {16 * 1024};
+
+// reads STRING_COUNT NUL terminated strings of STRING_SZ bytes each out of
+// a stream that received all of them already
+void bench_deserialize_strings() {
+	stream_pair p {4014};
+	p.remote->set_terminate_strings(true);
+	const std::string s(STRING_SZ, 'x');
+	for (std::size_t i {0}; i < STRING_COUNT; ++i) {
+		*p.remote << s;
+	}
+	std::thread sender {[&p] { p.remote->send(); }};
+	const std::size_t total = STRING_COUNT * (STRING_SZ + 1);
+	std::size_t got {0};
+	while (got < total) {
+		got += p.local->recv(total - got);
+	}
+	sender.join();
+	std::string out;
+	auto start = bench_clock::now();
+	for (std::size_t i {0}; i < STRING_COUNT; ++i) {
+		*p.local >> out;
+	}
+	report("deserialize std::string (1 KB)", total / seconds_since(start), "bytes/s");
+}
+
+constexpr std::size_t ID_COUNT {1024 * 1024};
+
+// ids below 2^14 as fixed 8 byte integers and as varints, reports the
+// decoding rate and how many bytes went over the wire per id
+void bench_varint() {
+	stream_pair p {4015};
+	std::vector<uint64_t> ids(ID_COUNT);
+	for (std::size_t i {0}; i < ID_COUNT; ++i) {
+		ids[i] = (i * 2654435761u) % 16384;
+	}
+	std::size_t varint_sz {0};
+	for (uint64_t id : ids) {
+		inet::byte scratch[inet::max_varint_size];
+		varint_sz += inet::varint_encode(scratch, id) - scratch;
+	}
+	p.remote->write_array(ids.data(), ids.size());
+	p.remote->write_varints(ids.data(), ids.size());
+	const std::size_t total = ID_COUNT * sizeof(uint64_t) + varint_sz;
+	std::thread sender {[&p] { p.remote->send(); }};
+	std::size_t got {0};
+	while (got < total) {
+		got += p.local->recv(total - got);
+	}
+	sender.join();
+	std::vector<uint64_t> out(ID_COUNT);
+	auto start = bench_clock::now();
+	p.local->read_array(out.data(), out.size());
+	report("decode fixed uint64_t", ID_COUNT / seconds_since(start), "ids/s");
+	start = bench_clock::now();
+	p.local->read_varints(out.data(), out.size());
+	report("decode varint uint64_t", ID_COUNT / seconds_since(start), "ids/s");
+	std::printf("%-44s %14.2f %s\n", "varint size", static_cast<double>(varint_sz) / ID_COUNT, "bytes/id");
+}
+
+constexpr std::size_t LOG_MSG_SZ {64 * 1024};
+constexpr int LOG_MSGS {1000};
+
+// log lines as a stand-in for text heavy payloads
+std::string log_payload() {
+	const char* levels[] = {"INFO", "WARN", "DEBUG"};
+	std::string s;
+	for (unsigned i {0}; s.size() < LOG_MSG_SZ; ++i) {
+		s += "2024-05-01T12:00:" + std::to_string(10 + i % 50) + " " + levels[i % 3] +
+		     " worker-" + std::to_string(i % 7) + " handled request id=" + std::to_string(i * 7919) +
+		     " path=/api/v1/items status=200\n";
+	}
+	s.resize(LOG_MSG_SZ);
+	return s;
+}
+// sends LOG_MSGS messages with send_message() and reports the payload
+// throughput on the receiving side
+void bench_messages(const char* name, unsigned short port, std::shared_ptr<const inet::codec> c,
+                    bool checksum = false) {
+	stream_pair p {port};
+	const std::string payload = log_payload();
+	if (c) {
+		std::vector<inet::byte> packed(c->max_compressed_size(payload.size()));
+		std::size_t n = c->compress(reinterpret_cast<const inet::byte*>(payload.data()), payload.size(),
+		                            packed.data());
+		std::printf("%-44s %14.2f %s\n", "lz compression ratio", static_cast<double>(payload.size()) / n, "x");
+	}
+	auto start = bench_clock::now();
+	std::thread sender {[&p, &payload, c, checksum] {
+		p.remote->set_codec(c);
+		p.remote->set_checksum(checksum);
+		for (int m {0}; m < LOG_MSGS; ++m) {
+			*p.remote << payload;
+			p.remote->send_message();
+		}
+	}};
+	for (int m {0}; m < LOG_MSGS; ++m) {
+		p.local->recv_message();
+		p.local->read_view(p.local->size());
+	}
+	sender.join();
+	report(name, LOG_MSG_SZ * LOG_MSGS / seconds_since(start), "bytes/s");
+}
+void bench_compression() {
+	bench_messages("messages, uncompressed", 4016, nullptr);
+	bench_messages("messages, lz codec", 4017, std::make_shared<inet::lz_codec>());
+}
+void bench_checksum() {
+	const std::string payload = log_payload();
+	uint32_t crc {0};
+	auto start = bench_clock::now();
+	for (int m {0}; m < LOG_MSGS; ++m) {
+		crc = inet::crc32c(payload.data(), payload.size(), crc);
+	}
+	std::printf("%-44s %14.3f %s\n", "crc32c", seconds_since(start) * 1e9 / (LOG_MSG_SZ * LOG_MSGS), "ns/byte");
+	start = bench_clock::now();
+	for (int m {0}; m < LOG_MSGS; ++m) {
+		crc = inet::crc32c_scalar(reinterpret_cast<const inet::byte*>(payload.data()), payload.size(), crc);
+	}
+	std::printf("%-44s %14.3f %s\n", "crc32c, lookup table", seconds_since(start) * 1e9 / (LOG_MSG_SZ * LOG_MSGS),
+	            "ns/byte");
+	std::printf("%-44s %14x\n", "checksum", crc);
+	bench_messages("messages, checksummed", 4018, nullptr, true);
+}
+
+constexpr int ACCEPT_CONNECTIONS {5000};
+
+// clients connect and hang up right away, reports accepted clients per
+// second
+void bench_accepts(const char* name, unsigned short port, bool batch) {
+	inet::server<inet::protocol::TCP> server {port, 1024};
+	server.set_nonblocking();
+	auto start = bench_clock::now();
+	std::thread connector {[port] {
+		for (int c {0}; c < ACCEPT_CONNECTIONS; ++c) {
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", port};
+			client.connect();
+		}
+	}};
+	int accepted {0};
+	while (accepted < ACCEPT_CONNECTIONS) {
+		server.select(std::chrono::milliseconds {1000});
+		if (batch) {
+			accepted += static_cast<int>(server.accept_all().size());
+			continue;
+		}
+		try {
+			server.accept();
+			++accepted;
+		}
+		catch (const std::system_error&) {
+			// woken up before the next client arrived
+		}
+	}
+	connector.join();
+	report(name, ACCEPT_CONNECTIONS / seconds_since(start), "accepts/s");
+}
+void bench_accept() {
+	bench_accepts("accept", 4019, false);
+	bench_accepts("accept_all", 4020, true);
+}
+
+struct benchmark {
+	const char* name;
+	void (*run)();
+};
+const benchmark benchmarks[] = {
+	{"echo_threads", bench_echo_threads},
+	{"echo_uring", bench_echo_uring},
+	{"echo_epoll", bench_echo_epoll},
+	{"echo_runtime", bench_echo_runtime},
+	{"serialize_ints", bench_serialize_ints},
+	{"serialize_strings", bench_serialize_strings},
+	{"serialize_pods", bench_serialize_pods},
+	{"serialize_arrays", bench_serialize_arrays},
+	{"deserialize_strings", bench_deserialize_strings},
+	{"varint", bench_varint},
+	{"compression", bench_compression},
+	{"checksum", bench_checksum},
+	{"accept", bench_accept},
+	{"udp_batch", bench_udp_batch},
+	{"bulk_send", bench_bulk_send},
+};
+} // namespace
+
+int main(int argc, char** argv) {
+	for (const benchmark& b : benchmarks) {
+		bool selected = argc == 1;
+		for (int i {1}; i < argc; ++i) {
+			selected |= std::strcmp(argv[i], b.name) == 0;
+		}
+		if (selected) {
+			b.run();
+		}
+	}
+}
@@ -0,0 +1,176 @@
+#include "Catch2/include/catch.hpp"
+
+#define INET_USE_DEFAULT_SIGUSR1_HANDLER true
+#include "../inetstream_coro.hpp"
+
+#include <thread>
+#include <chrono>
+#include <sys/resource.h>
+#include <dirent.h>
+
+namespace {
+inet::co_task echo_doubled(inet::event_loop& loop, inet::inetstream<inet::protocol::TCP> istr, int& finished) {
+	inet::async_stream s {loop, std::move(istr)};
+	while (co_await s.async_recv(4) == 4) {
+		int i {};
+		*s >> i;
+		*s << i * 2;
+		co_await s.async_send();
+	}
+	++finished;
+}
+constexpr std::size_t large_sz {8 * 1024 * 1024};
+inet::co_task send_large(inet::event_loop& loop, inet::async_server& srv, std::size_t& sent, bool& done) {
+	inet::async_stream s {loop, co_await srv.async_accept()};
+	for (std::size_t i {0}; i < large_sz; ++i) {
+		*s << static_cast<inet::byte>(i);
+	}
+	sent = co_await s.async_send();
+	done = true;
+}
+inet::co_task fail_after_recv(inet::event_loop& loop, inet::inetstream<inet::protocol::TCP> istr) {
+	inet::async_stream s {loop, std::move(istr)};
+	co_await s.async_recv(4);
+	throw std::logic_error {"session failed"};
+}
+inet::co_task keep_clients(inet::async_server& srv, std::size_t clients,
+                           std::vector<inet::inetstream<inet::protocol::TCP>>& accepted) {
+	while (accepted.size() < clients) {
+		accepted.push_back(co_await srv.async_accept());
+	}
+}
+inet::co_task accept_clients(inet::event_loop& loop, inet::async_server& srv, int clients, int& finished) {
+	for (int c {0}; c < clients; ++c) {
+		echo_doubled(loop, co_await srv.async_accept(), finished);
+	}
+}
+}
+
+TEST_CASE("coroutine accept, recv and send") {
+	constexpr int clients {8};
+	constexpr int rounds {5};
+	inet::server<inet::protocol::TCP> server {3700, 16};
+	inet::event_loop loop;
+	inet::async_server srv {loop, server};
+	int finished {0};
+	accept_clients(loop, srv, clients, finished);
+	std::vector<std::thread> threads;
+	for (int c {0}; c < clients; ++c) {
+		threads.emplace_back([c] {
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", 3700};
+			auto istr = client.connect();
+			for (int r {0}; r < rounds; ++r) {
+				istr << c + r;
+				istr.send();
+				REQUIRE(istr.recv(4, std::chrono::milliseconds {1000}) == 4);
+				int i {};
+				istr >> i;
+				REQUIRE(i == (c + r) * 2);
+			}
+		});
+	}
+	auto t_end = std::chrono::steady_clock::now() + std::chrono::seconds {5};
+	while (finished < clients && std::chrono::steady_clock::now() < t_end) {
+		loop.run_once(std::chrono::milliseconds {100});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	REQUIRE(finished == clients);
+	INFO("only the server is left in the loop");
+	REQUIRE(loop.size() == 1);
+}
+
+TEST_CASE("coroutine send of a large buffer") {
+	inet::server<inet::protocol::TCP> server {3701};
+	inet::event_loop loop;
+	inet::async_server srv {loop, server};
+	std::size_t sent {0};
+	bool done {false};
+	send_large(loop, srv, sent, done);
+	std::thread t {[] {
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3701};
+		auto istr = client.connect();
+		REQUIRE(istr.recv(large_sz, std::chrono::milliseconds {5000}) == large_sz);
+		inet::view v = istr.read_view(large_sz);
+		for (std::size_t i {0}; i < large_sz; i += 4099) {
+			REQUIRE(v[i] == static_cast<inet::byte>(i));
+		}
+	}};
+	auto t_end = std::chrono::steady_clock::now() + std::chrono::seconds {5};
+	while (!done && std::chrono::steady_clock::now() < t_end) {
+		loop.run_once(std::chrono::milliseconds {100});
+	}
+	t.join();
+	REQUIRE(done);
+	REQUIRE(sent == large_sz);
+}
+
+TEST_CASE("coroutine exceptions go to the error handler") {
+	inet::server<inet::protocol::TCP> server {3702};
+	inet::event_loop loop;
+	std::string error;
+	inet::co_task::set_error_handler([&error](std::exception_ptr e) {
+		try {
+			std::rethrow_exception(e);
+		}
+		catch (const std::logic_error& ex) {
+			error = ex.what();
+		}
+	});
+	INFO("every thread has a handler of its own");
+	std::thread {[] { inet::co_task::set_error_handler(nullptr); }}.join();
+	inet::client<inet::protocol::TCP> client {"127.0.0.1", 3702};
+	auto istr = client.connect();
+	fail_after_recv(loop, server.accept());
+	istr << 1;
+	istr.send();
+	auto t_end = std::chrono::steady_clock::now() + std::chrono::seconds {5};
+	while (error.empty() && std::chrono::steady_clock::now() < t_end) {
+		loop.run_once(std::chrono::milliseconds {100});
+	}
+	inet::co_task::set_error_handler(nullptr);
+	REQUIRE(error == "session failed");
+}
+
+TEST_CASE("coroutine accept goes on after running out of descriptors") {
+	constexpr std::size_t clients {6};
+	inet::server<inet::protocol::TCP> server {3703, 32};
+	inet::event_loop loop;
+	inet::async_server srv {loop, server};
+	std::vector<inet::inetstream<inet::protocol::TCP>> accepted;
+	keep_clients(srv, clients, accepted);
+	std::vector<inet::inetstream<inet::protocol::TCP>> conns;
+	for (std::size_t c {0}; c < clients; ++c) {
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3703};
+		conns.push_back(client.connect());
+	}
+	int max_fd {0};
+	DIR* d = opendir("/proc/self/fd");
+	REQUIRE(d != nullptr);
+	while (dirent* e = readdir(d)) {
+		max_fd = std::max(max_fd, std::atoi(e->d_name));
+	}
+	closedir(d);
+	rlimit old {};
+	REQUIRE(getrlimit(RLIMIT_NOFILE, &old) == 0);
+	rlimit low {old};
+	// room for a couple of clients only
+	low.rlim_cur = static_cast<rlim_t>(max_fd + 3);
+	REQUIRE(setrlimit(RLIMIT_NOFILE, &low) == 0);
+	bool threw {false};
+	try {
+		loop.run_once(std::chrono::milliseconds {100});
+	}
+	catch (const std::exception&) {
+		threw = true;
+	}
+	REQUIRE(setrlimit(RLIMIT_NOFILE, &old) == 0);
+	REQUIRE_FALSE(threw);
+	REQUIRE(accepted.size() < clients);
+	auto t_end = std::chrono::steady_clock::now() + std::chrono::seconds {5};
+	while (accepted.size() < clients && std::chrono::steady_clock::now() < t_end) {
+		loop.run_once(std::chrono::milliseconds {100});
+	}
+	REQUIRE(accepted.size() == clients);
+}
@@ -5,6 +5,48 @@
 
 #include <thread>
 #include <chrono>
+#include <set>
+#include <sys/resource.h>
+#include <dirent.h>
+
+namespace {
+/**
+ * lowers the limit on open descriptors to leave room for spare more while
+ * it lives
+ */
+struct fd_limit {
+	explicit fd_limit(int spare) {
+		int max_fd {0};
+		DIR* d = opendir("/proc/self/fd");
+		REQUIRE(d != nullptr);
+		while (dirent* e = readdir(d)) {
+			max_fd = std::max(max_fd, std::atoi(e->d_name));
+		}
+		closedir(d);
+		REQUIRE(getrlimit(RLIMIT_NOFILE, &old) == 0);
+		rlimit low {old};
+		low.rlim_cur = static_cast<rlim_t>(max_fd + spare);
+		REQUIRE(setrlimit(RLIMIT_NOFILE, &low) == 0);
+	}
+	~fd_limit() {
+		setrlimit(RLIMIT_NOFILE, &old);
+	}
+	rlimit old {};
+};
+// connects to port and resets the connection before anyone accepts it
+void abort_connect(unsigned short port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	REQUIRE(fd != -1);
+	sockaddr_in addr {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == 0);
+	linger l {1, 0};
+	REQUIRE(setsockopt(fd, SOL_SOCKET, SO_LINGER, &l, sizeof l) == 0);
+	close(fd);
+}
+}
 
 TEST_CASE("test creating tcp server and getting inetstream") {
 	std::thread t {[] {
@@ -349,8 +391,9 @@ TEST_CASE("test receiving twice, then reading all data on stream") {
 		int i_1 {42}, i_2 {1337};
 		istr << i_1;
 		istr.send();
+		// let the first recv() on the other end time out before sending again
 		std::this_thread::sleep_for(std::chrono::milliseconds{
-				INET_MAX_RECV_TIMEOUT_MS});
+				INET_MAX_RECV_TIMEOUT_MS + 100});
 		istr.clear();
 		istr << i_2;
 		istr.send();
@@ -381,8 +424,9 @@ TEST_CASE("test receiving twice, but reading one by one") {
 		int i_1 {42}, i_2 {1337};
 		istr << i_1;
 		istr.send();
+		// let the first recv() on the other end time out before sending again
 		std::this_thread::sleep_for(std::chrono::milliseconds{
-				INET_MAX_RECV_TIMEOUT_MS});
+				INET_MAX_RECV_TIMEOUT_MS + 100});
 		istr.clear();
 		istr << i_2;
 		istr.send();
@@ -763,3 +807,1296 @@ TEST_CASE("non-blocking accept") {
 	REQUIRE(i == 1337);
 	t1.join();
 }
+TEST_CASE("event_loop serves multiple clients from one thread") {
+	constexpr int N_CLIENTS {8};
+	std::vector<std::thread> clients;
+	for (int c {0}; c < N_CLIENTS; ++c) {
+		clients.emplace_back([c] {
+			std::this_thread::sleep_for(std::chrono::milliseconds{10});
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", 3262};
+			auto istr = client.connect();
+			istr << c;
+			istr.send();
+			istr.recv(4);
+			REQUIRE(istr.size() == 4);
+			int i {};
+			istr >> i;
+			REQUIRE(i == c + 1);
+		});
+	}
+	inet::server<inet::protocol::TCP> server {3262};
+	inet::event_loop loop;
+	std::vector<std::unique_ptr<inet::inetstream<inet::protocol::TCP>>> conns;
+	int answered {0};
+	loop.add(server, [&](inet::inetstream<inet::protocol::TCP>&& istr) {
+		conns.emplace_back(new inet::inetstream<inet::protocol::TCP> {std::move(istr)});
+		loop.add(*conns.back(), [&](inet::inetstream<inet::protocol::TCP>& s) {
+			while (s.recv(4, std::chrono::milliseconds {0}) > 0) {}
+			if (s.size() < 4) {
+				return;
+			}
+			int i {};
+			s >> i;
+			s.clear();
+			s << i + 1;
+			s.send();
+			if (++answered == N_CLIENTS) {
+				loop.stop();
+			}
+		});
+	});
+	REQUIRE(loop.size() == 1);
+	loop.run();
+	REQUIRE(loop.size() == N_CLIENTS + 1);
+	for (auto& istr : conns) {
+		loop.remove(*istr);
+	}
+	REQUIRE(loop.size() == 1);
+	for (auto& t : clients) {
+		t.join();
+	}
+}
+TEST_CASE("idle recv() sleeps instead of spinning") {
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3263};
+		auto istr = client.connect();
+		std::this_thread::sleep_for(std::chrono::milliseconds{300});
+		istr << 42;
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3263};
+	auto istr = server.accept();
+	timespec cpu_start {}, cpu_end {};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+	auto start_t = std::chrono::steady_clock::now();
+	REQUIRE(istr.recv(4) == 4);
+	auto waited = std::chrono::steady_clock::now() - start_t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+	auto cpu = std::chrono::seconds {cpu_end.tv_sec - cpu_start.tv_sec} +
+	           std::chrono::nanoseconds {cpu_end.tv_nsec - cpu_start.tv_nsec};
+	INFO("recv() should have waited for the data without burning cpu");
+	REQUIRE(waited >= std::chrono::milliseconds {200});
+	REQUIRE(cpu < std::chrono::milliseconds {50});
+	int i {};
+	istr >> i;
+	REQUIRE(i == 42);
+	t1.join();
+}
+TEST_CASE("arrays and vectors") {
+	std::vector<uint32_t> ints(10000);
+	for (std::size_t i {0}; i < ints.size(); ++i) {
+		ints[i] = static_cast<uint32_t>(i * 0x01010101);
+	}
+	std::array<double, 7> doubles {{0.5, -1.25, 3.1415926535, 1e300, -0.0, 42.0, 1e-300}};
+	int16_t shorts[3] {-1, 0x1234, 7};
+	std::thread t1 {[&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3264};
+		auto istr = client.connect();
+		istr << ints << doubles;
+		istr.write_array(shorts, 3);
+		// empty arrays add nothing
+		istr << std::vector<uint32_t> {};
+		istr.write_array(static_cast<const int16_t*>(nullptr), 0);
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3264};
+	auto istr = server.accept();
+	constexpr std::size_t total = 10000 * sizeof(uint32_t) + 7 * sizeof(double) + 3 * sizeof(int16_t);
+	while (istr.size() < total && istr.recv(total - istr.size()) > 0) {}
+	REQUIRE(istr.size() == total);
+	// same wire format as pushing one by one
+	uint32_t first {}, second {};
+	istr >> first;
+	istr >> second;
+	REQUIRE(first == ints[0]);
+	REQUIRE(second == ints[1]);
+	std::vector<uint32_t> ints_in(ints.size() - 2);
+	istr >> ints_in;
+	REQUIRE(std::equal(ints_in.begin(), ints_in.end(), ints.begin() + 2));
+	std::array<double, 7> doubles_in {};
+	istr >> doubles_in;
+	REQUIRE(doubles_in == doubles);
+	int16_t shorts_in[3] {};
+	istr.read_array(shorts_in, 3);
+	REQUIRE(std::equal(shorts, shorts + 3, shorts_in));
+	REQUIRE_THROWS_AS(istr.read_array(shorts_in, 1), std::runtime_error);
+	std::vector<uint32_t> none;
+	istr >> none;
+	REQUIRE(istr.size() == 0);
+	t1.join();
+}
+TEST_CASE("length-prefixed messages") {
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3265};
+		auto istr = client.connect();
+		// pipelined, likely to arrive in one read
+		istr << 1 << 2;
+		istr.send_message();
+		istr.send_message();
+		istr << "Hello, World!";
+		istr.send_message();
+		istr << 3;
+		istr.send_message();
+		REQUIRE(istr.recv_message());
+		REQUIRE(istr.size() == 4);
+		int i {};
+		istr >> i;
+		REQUIRE(i == 6);
+	}};
+	inet::server<inet::protocol::TCP> server {3265};
+	auto istr = server.accept();
+	REQUIRE(istr.recv_message());
+	REQUIRE(istr.size() == 8);
+	int a {}, b {};
+	istr >> a;
+	istr >> b;
+	REQUIRE(a + b == 3);
+	REQUIRE_THROWS_AS(istr >> a, std::runtime_error);
+	INFO("empty message");
+	REQUIRE(istr.recv_message());
+	REQUIRE(istr.size() == 0);
+	REQUIRE(istr.recv_message());
+	REQUIRE(istr.size() == sizeof("Hello, World!") - 1);
+	char c {};
+	istr >> c;
+	REQUIRE(c == 'H');
+	INFO("unread rest of the previous message is skipped");
+	REQUIRE(istr.recv_message());
+	int d {};
+	istr >> d;
+	REQUIRE(d == 3);
+	istr << a + b + d;
+	istr.send_message();
+	INFO("nothing left to receive");
+	REQUIRE_FALSE(istr.recv_message(std::chrono::milliseconds {10}));
+	t1.join();
+}
+namespace {
+// remembers the largest buffer handed out
+struct watching_pool : inet::buffer_pool {
+	std::size_t largest {0};
+	void* allocate(std::size_t sz) override {
+		largest = std::max(largest, sz);
+		return inet::buffer_pool::allocate(sz);
+	}
+};
+}
+TEST_CASE("clear_send() and clear_recv()") {
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3266};
+		auto istr = client.connect();
+		for (int i {0}; i < 1000; ++i) {
+			istr << i;
+		}
+		istr.send();
+		REQUIRE(istr.recv(4) == 4);
+		int i {};
+		istr >> i;
+		REQUIRE(i == 1337);
+		istr << 7 << 8;
+		istr.send();
+		REQUIRE(istr.recv(4) == 4);
+		istr >> i;
+		REQUIRE(i == 2);
+		istr << 9;
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3266};
+	auto istr = server.accept();
+	auto pool = std::make_shared<watching_pool>();
+	istr.set_buffer_pool(pool);
+	// small reads, so consumed bytes get dropped while receiving
+	for (int i {0}; i < 1000; ++i) {
+		if (istr.size() < 4) {
+			REQUIRE(istr.recv(std::min(12, 4 * (1000 - i))) > 0);
+		}
+		int j {};
+		istr >> j;
+		REQUIRE(i == j);
+	}
+	REQUIRE(istr.size() == 0);
+	INFO("the receive buffer never held all 4000 bytes");
+	REQUIRE(pool->largest < 1024);
+	istr << 1;
+	istr.clear_send();
+	istr << 1337;
+	istr.send();
+	REQUIRE(istr.empty());
+	REQUIRE(istr.recv(8, std::chrono::milliseconds {1000}) == 8);
+	istr << 2;
+	istr.send();
+	INFO("replying keeps unread data, clear_recv() drops it");
+	REQUIRE(istr.size() == 8);
+	istr.clear_recv();
+	REQUIRE(istr.size() == 0);
+	REQUIRE(istr.empty());
+	REQUIRE(istr.recv(4, std::chrono::milliseconds {1000}) == 4);
+	int j {};
+	istr >> j;
+	REQUIRE(j == 9);
+	t1.join();
+}
+TEST_CASE("bulk recv() with adaptive read size") {
+	constexpr std::size_t SZ {4 * 1024 * 1024};
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3267};
+		auto istr = client.connect();
+		std::vector<uint32_t> v(SZ / sizeof(uint32_t));
+		for (std::size_t i {0}; i < v.size(); ++i) {
+			v[i] = static_cast<uint32_t>(i);
+		}
+		istr << v;
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3267};
+	auto istr = server.accept();
+	REQUIRE(istr.read_size() == INET_DEFAULT_READ_SIZE);
+	istr.set_adaptive_read(true);
+	while (istr.size() < SZ && istr.recv(SZ - istr.size()) > 0) {}
+	REQUIRE(istr.size() == SZ);
+	std::vector<uint32_t> v(SZ / sizeof(uint32_t));
+	istr >> v;
+	bool in_order {true};
+	for (std::size_t i {0}; i < v.size(); ++i) {
+		in_order &= v[i] == i;
+	}
+	REQUIRE(in_order);
+	INFO("reads filling the read size should have grown it");
+	REQUIRE(istr.read_size() > INET_DEFAULT_READ_SIZE);
+	t1.join();
+}
+
+TEST_CASE("sending referenced buffers without copying") {
+	bool released {false};
+	std::thread t1 {[&released] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3268};
+		auto istr = client.connect();
+		auto blob = std::make_shared<std::vector<inet::byte>>(100000, 7);
+		static const char tail[] = "tail";
+		istr << static_cast<uint32_t>(blob->size());
+		istr.write_ref(blob);
+		istr.write_ref(tail, 4, [&released] { released = true; });
+		istr << static_cast<uint16_t>(0xbeef);
+		blob.reset();
+		istr.send();
+		REQUIRE(released);
+		INFO("referenced buffers count towards the message length");
+		auto small = std::make_shared<std::string>("abc");
+		istr << 'x';
+		istr.write_ref(small);
+		istr.send_message();
+		REQUIRE(small.use_count() == 1);
+	}};
+	inet::server<inet::protocol::TCP> server {3268};
+	auto istr = server.accept();
+	REQUIRE(istr.recv(4 + 100000 + 4 + 2) == 4 + 100000 + 4 + 2);
+	uint32_t n {};
+	istr >> n;
+	REQUIRE(n == 100000);
+	std::vector<inet::byte> v(n);
+	istr >> v;
+	REQUIRE(std::count(v.begin(), v.end(), 7) == 100000);
+	char c[4] = {};
+	for (char& ch : c) {
+		istr >> ch;
+	}
+	REQUIRE(std::string(c, 4) == "tail");
+	uint16_t s {};
+	istr >> s;
+	REQUIRE(s == 0xbeef);
+	REQUIRE(istr.recv_message());
+	REQUIRE(istr.size() == 4);
+	istr >> c[0];
+	REQUIRE(c[0] == 'x');
+	t1.join();
+	REQUIRE(released);
+}
+
+TEST_CASE("zero-copy sends") {
+	constexpr std::size_t big {1024 * 1024};
+	bool released {false};
+	std::thread t1 {[&released, big] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3269};
+		auto istr = client.connect();
+		istr.set_zerocopy(true);
+		INFO("small sends are copied");
+		istr << 1;
+		istr.send();
+		REQUIRE(istr.zerocopy_pending() == 0);
+		auto blob = std::make_shared<std::vector<inet::byte>>(big, 9);
+		const inet::byte* p = blob->data();
+		istr << 2;
+		istr.write_ref(p, big, [blob, &released] { released = true; });
+		blob.reset();
+		istr.send_message();
+		REQUIRE(istr.zerocopy_pending() == 1);
+		REQUIRE(istr.recv(4) == 4);
+		REQUIRE(istr.flush_zerocopy(std::chrono::milliseconds {1000}));
+		REQUIRE(istr.zerocopy_pending() == 0);
+		REQUIRE(released);
+	}};
+	inet::server<inet::protocol::TCP> server {3269};
+	auto istr = server.accept();
+	REQUIRE(istr.recv(4) == 4);
+	int i {};
+	istr >> i;
+	REQUIRE(i == 1);
+	REQUIRE(istr.recv_message());
+	REQUIRE(istr.size() == 4 + big);
+	istr >> i;
+	REQUIRE(i == 2);
+	std::vector<inet::byte> v(big);
+	istr >> v;
+	REQUIRE(std::count(v.begin(), v.end(), 9) == static_cast<long>(big));
+	istr << 3;
+	istr.send();
+	t1.join();
+}
+
+TEST_CASE("streaming files with sendfile() and splice()") {
+	constexpr std::size_t file_sz {3 * 1024 * 1024 + 17};
+	char src_name[] = "/tmp/inetstream_src_XXXXXX";
+	char dst_name[] = "/tmp/inetstream_dst_XXXXXX";
+	int src = mkstemp(src_name);
+	int dst = mkstemp(dst_name);
+	REQUIRE(src != -1);
+	REQUIRE(dst != -1);
+	std::vector<inet::byte> data(file_sz);
+	for (std::size_t i {0}; i < file_sz; ++i) {
+		data[i] = static_cast<inet::byte>(i * 31);
+	}
+	REQUIRE(write(src, data.data(), file_sz) == static_cast<ssize_t>(file_sz));
+	std::thread t1 {[src, file_sz] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3270};
+		auto istr = client.connect();
+		INFO("pushed data goes out before the file");
+		istr << static_cast<uint64_t>(file_sz - 1);
+		std::size_t last {0};
+		REQUIRE(istr.send_file(src, 1, file_sz - 1, [&last](std::size_t done) { last = done; }) == file_sz - 1);
+		REQUIRE(last == file_sz - 1);
+		INFO("sending past the end of the file stops early");
+		REQUIRE(istr.send_file(src, file_sz - 2, 10) == 2);
+	}};
+	inet::server<inet::protocol::TCP> server {3270};
+	auto istr = server.accept();
+	REQUIRE(istr.recv(8) == 8);
+	uint64_t len {};
+	istr >> len;
+	REQUIRE(len == file_sz - 1);
+	std::size_t calls {0};
+	REQUIRE(istr.recv_to_file(dst, len + 2, [&calls](std::size_t) { ++calls; }) == len + 2);
+	REQUIRE(calls > 1);
+	t1.join();
+	std::vector<inet::byte> got(len + 2);
+	REQUIRE(pread(dst, got.data(), got.size(), 0) == static_cast<ssize_t>(got.size()));
+	REQUIRE(std::equal(data.begin() + 1, data.end(), got.begin()));
+	REQUIRE(std::equal(data.end() - 2, data.end(), got.end() - 2));
+	close(src);
+	close(dst);
+	unlink(src_name);
+	unlink(dst_name);
+}
+
+struct counting_pool : inet::buffer_pool {
+	void* allocate(std::size_t sz) override {
+		++allocations;
+		return inet::buffer_pool::allocate(sz);
+	}
+	int allocations {0};
+};
+
+TEST_CASE("buffers of accepted streams come from the server's pool") {
+	std::thread t1 {[] {
+		for (int c {0}; c < 3; ++c) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{10});
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", 3271};
+			auto istr = client.connect();
+			istr << c;
+			istr.send();
+			REQUIRE(istr.recv(4) == 4);
+		}
+	}};
+	inet::server<inet::protocol::TCP> server {3271};
+	auto pool = server.get_buffer_pool();
+	REQUIRE(pool);
+	REQUIRE(pool->idle() == 0);
+	std::size_t idle {0};
+	{
+		auto istr = server.accept();
+		REQUIRE(istr.recv(4) == 4);
+		int i {};
+		istr >> i;
+		istr << i;
+		istr.send();
+	}
+	INFO("buffers go back to the pool when the stream is destroyed");
+	idle = pool->idle();
+	REQUIRE(idle > 0);
+	{
+		auto istr = server.accept();
+		REQUIRE(istr.recv(4) == 4);
+		REQUIRE(pool->idle() < idle);
+		istr << 1;
+		istr.send();
+	}
+	REQUIRE(pool->idle() == idle);
+	auto counting = std::make_shared<counting_pool>();
+	server.set_buffer_pool(counting);
+	{
+		auto istr = server.accept();
+		REQUIRE(istr.recv(4) == 4);
+		istr << 2;
+		istr.send();
+	}
+	REQUIRE(counting->allocations >= 2);
+	t1.join();
+}
+
+TEST_CASE("reading views into the receive buffer") {
+	const std::string request {"GET /index.html\r\nHost: example.org\r\n\r\nbody"};
+	std::thread t1 {[&request] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3272};
+		auto istr = client.connect();
+		istr << request;
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3272};
+	auto istr = server.accept();
+	REQUIRE(istr.recv(request.size()) == request.size());
+	t1.join();
+	std::vector<std::string> lines;
+	inet::view line;
+	while (istr.read_until('\n', line) && line.size() > 1) {
+		REQUIRE(line[line.size() - 1] == '\r');
+		lines.push_back(std::string(line.chars(), line.size() - 1));
+	}
+	REQUIRE(lines.size() == 2);
+	REQUIRE(lines[0] == "GET /index.html");
+	REQUIRE(lines[1] == "Host: example.org");
+	INFO("no delimiter left, nothing is consumed");
+	REQUIRE_FALSE(istr.read_until('\n', line));
+	REQUIRE(istr.size() == 4);
+	inet::view body = istr.read_view(4);
+	REQUIRE(body.str() == "body");
+	REQUIRE(istr.empty());
+	REQUIRE(istr.read_view(0).empty());
+	REQUIRE_THROWS_AS(istr.read_view(1), std::runtime_error);
+}
+
+TEST_CASE("NUL terminated strings") {
+	const std::string big(4096, 'k');
+	std::thread t1 {[&big] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3273};
+		auto istr = client.connect();
+		istr.set_terminate_strings(true);
+		istr << "first" << std::string {} << big;
+		istr.set_terminate_strings(false);
+		istr << "un" << "terminated";
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3273};
+	auto istr = server.accept();
+	const std::size_t total {6 + 1 + big.size() + 1 + 12};
+	REQUIRE(istr.recv(total) == total);
+	t1.join();
+	std::string s;
+	istr >> s;
+	REQUIRE(s == "first");
+	istr >> s;
+	REQUIRE(s.empty());
+	istr >> s;
+	REQUIRE(s == big);
+	istr >> s;
+	REQUIRE(s == "unterminated");
+	REQUIRE(istr.empty());
+	istr >> s;
+	REQUIRE(s.empty());
+}
+
+enum class color : uint8_t { red = 1, green = 2 };
+struct position {
+	int16_t x, y;
+	double z;
+};
+INET_SCHEMA(position, INET_FIELD(position, x), INET_FIELD(position, y), INET_FIELD(position, z));
+struct entity {
+	uint8_t kind;
+	bool alive;
+	color c;
+	position pos;
+	std::array<uint32_t, 3> ids;
+	std::string name;
+	uint64_t seq;
+};
+INET_SCHEMA(entity, INET_FIELD(entity, kind), INET_FIELD(entity, alive), INET_FIELD(entity, c),
+            INET_FIELD(entity, pos), INET_FIELD(entity, ids), INET_FIELD(entity, name),
+            INET_FIELD(entity, seq));
+
+static_assert(inet::wire<position>::fixed && inet::wire<position>::size == 12, "packed position");
+static_assert(!inet::wire<entity>::fixed && inet::wire<entity>::size == 1 + 1 + 1 + 12 + 12 + 4 + 8,
+              "minimum entity size");
+
+TEST_CASE("structs described by a schema") {
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3274};
+		auto istr = client.connect();
+		istr << position {0x0102, -2, 0.5};
+		entity e {7, true, color::green, {1, 2, 3.0}, {{10, 20, 30}}, "orc", 0x0102030405060708};
+		istr << e;
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3274};
+	auto istr = server.accept();
+	const std::size_t total {12 + inet::wire<entity>::size + 3};
+	REQUIRE(istr.recv(total) == total);
+	t1.join();
+	INFO("fields go out packed and in network byte order");
+	inet::view raw = istr.read_view(2);
+	REQUIRE(raw[0] == 0x01);
+	REQUIRE(raw[1] == 0x02);
+	int16_t y {};
+	istr >> y;
+	REQUIRE(y == -2);
+	double z {};
+	istr >> z;
+	REQUIRE(z == 0.5);
+	entity e {};
+	istr >> e;
+	REQUIRE(e.kind == 7);
+	REQUIRE(e.alive);
+	REQUIRE(e.c == color::green);
+	REQUIRE(e.pos.x == 1);
+	REQUIRE(e.pos.y == 2);
+	REQUIRE(e.pos.z == 3.0);
+	REQUIRE(e.ids[2] == 30);
+	REQUIRE(e.name == "orc");
+	REQUIRE(e.seq == 0x0102030405060708);
+	REQUIRE(istr.empty());
+	INFO("structs need all of their bytes received");
+	position p {};
+	REQUIRE_THROWS_AS(istr >> p, std::runtime_error);
+}
+
+struct record {
+	std::string name;
+	int32_t seq;
+};
+INET_SCHEMA(record, INET_FIELD(record, name), INET_FIELD(record, seq));
+
+TEST_CASE("structs with a hostile length prefix") {
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3284};
+		auto istr = client.connect();
+		// the string fits, but leaves no room for seq
+		istr << static_cast<uint32_t>(4) << 'a' << 'b' << 'c' << 'd';
+		istr.send_message();
+		istr << record {"next", 1};
+		istr.send_message();
+	}};
+	inet::server<inet::protocol::TCP> server {3284};
+	auto istr = server.accept();
+	REQUIRE(istr.recv_message());
+	record r {"keep", 42};
+	REQUIRE_THROWS_AS(istr >> r, std::runtime_error);
+	INFO("a struct that fails to decode keeps all of its fields");
+	REQUIRE(r.name == "keep");
+	REQUIRE(r.seq == 42);
+	REQUIRE(istr.size() == 8);
+	INFO("the next message is left alone");
+	REQUIRE(istr.recv_message());
+	istr >> r;
+	REQUIRE(r.name == "next");
+	REQUIRE(r.seq == 1);
+	t1.join();
+}
+
+TEST_CASE("varint and zigzag encoding") {
+	const std::vector<uint64_t> unsigned_values {0, 1, 127, 128, 300, (1ULL << 56) - 1, 1ULL << 56,
+	                                             1ULL << 63, UINT64_MAX};
+	const std::vector<int32_t> signed_values {0, -1, 1, -64, 64, INT32_MIN, INT32_MAX};
+	std::thread t1 {[&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3275};
+		auto istr = client.connect();
+		istr << inet::varint(static_cast<uint32_t>(1)) << inet::varint(static_cast<int64_t>(-1));
+		istr << inet::varint(static_cast<uint16_t>(300));
+		istr.write_varints(unsigned_values.data(), unsigned_values.size());
+		istr.write_varints(signed_values.data(), signed_values.size());
+		istr.send();
+	}};
+	inet::server<inet::protocol::TCP> server {3275};
+	auto istr = server.accept();
+	// 1 + 1 + 2, then 1 + 1 + 1 + 2 + 2 + 8 + 9 + 10 + 10, then 1 + 1 + 1 + 1 + 2 + 5 + 5
+	const std::size_t total {4 + 44 + 16};
+	REQUIRE(istr.recv(total) == total);
+	t1.join();
+	INFO("small values take a single byte");
+	REQUIRE(istr.size() == total);
+	uint32_t u {};
+	int64_t i {};
+	istr >> inet::varint(u);
+	istr >> inet::varint(i);
+	REQUIRE(u == 1);
+	REQUIRE(i == -1);
+	INFO("values too large for the variable are rejected");
+	uint8_t small {7};
+	REQUIRE_THROWS_AS(istr >> inet::varint(small), std::runtime_error);
+	REQUIRE(small == 7);
+	uint16_t medium {};
+	istr >> inet::varint(medium);
+	REQUIRE(medium == 300);
+	std::vector<uint64_t> us(unsigned_values.size());
+	istr.read_varints(us.data(), us.size());
+	REQUIRE(us == unsigned_values);
+	std::vector<int32_t> ss(signed_values.size());
+	istr.read_varints(ss.data(), ss.size());
+	REQUIRE(ss == signed_values);
+	REQUIRE(istr.empty());
+	REQUIRE_THROWS_AS(istr >> inet::varint(u), std::runtime_error);
+}
+
+TEST_CASE("lz codec round trip") {
+	inet::lz_codec lz;
+	std::vector<std::vector<inet::byte>> inputs;
+	inputs.emplace_back();
+	inputs.emplace_back(1, 'a');
+	inputs.emplace_back(13, 'b');
+	inputs.emplace_back(100000, 'c');
+	std::vector<inet::byte> text;
+	const std::string words[] = {"lorem ", "ipsum ", "dolor ", "sit ", "amet, "};
+	uint32_t seed {1};
+	for (int i {0}; i < 20000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		const std::string& w = words[(seed >> 16) % 5];
+		text.insert(text.end(), w.begin(), w.end());
+	}
+	inputs.push_back(text);
+	std::vector<inet::byte> noise(70000);
+	for (auto& b : noise) {
+		seed = seed * 1103515245 + 12345;
+		b = static_cast<inet::byte>(seed >> 16);
+	}
+	inputs.push_back(noise);
+	for (const auto& in : inputs) {
+		std::vector<inet::byte> packed(lz.max_compressed_size(in.size()));
+		std::size_t n = lz.compress(in.data(), in.size(), packed.data());
+		REQUIRE(n <= packed.size());
+		std::vector<inet::byte> out(in.size());
+		REQUIRE(lz.decompress(packed.data(), n, out.data(), out.size()));
+		REQUIRE(out == in);
+		if (in.size() > 1000) {
+			INFO("truncated or resized input is rejected");
+			REQUIRE_FALSE(lz.decompress(packed.data(), n - 1, out.data(), out.size()));
+			REQUIRE_FALSE(lz.decompress(packed.data(), n, out.data(), out.size() - 1));
+		}
+	}
+	std::vector<inet::byte> packed(lz.max_compressed_size(text.size()));
+	REQUIRE(lz.compress(text.data(), text.size(), packed.data()) * 2 < text.size());
+}
+
+TEST_CASE("compressed messages") {
+	const std::string text = [] {
+		std::string s;
+		for (int i {0}; i < 1000; ++i) {
+			s += "the quick brown fox jumps over the lazy dog " + std::to_string(i % 10);
+		}
+		return s;
+	}();
+	std::thread t1 {[&text] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3276};
+		auto istr = client.connect();
+		istr.set_codec(std::make_shared<inet::lz_codec>(), 64);
+		istr << text;
+		istr.send_message();
+		INFO("small messages stay uncompressed");
+		istr << 42;
+		istr.send_message();
+		auto shared = std::make_shared<std::string>(text);
+		istr << 7;
+		istr.write_ref(shared);
+		istr.send_message();
+		istr.set_codec(nullptr);
+		istr << text;
+		istr.send_message();
+	}};
+	inet::server<inet::protocol::TCP> server {3276};
+	auto istr = server.accept();
+	for (int m {0}; m < 4; ++m) {
+		REQUIRE(istr.recv_message());
+		if (m == 1) {
+			REQUIRE(istr.size() == 4);
+			int i {};
+			istr >> i;
+			REQUIRE(i == 42);
+			continue;
+		}
+		if (m == 2) {
+			int i {};
+			istr >> i;
+			REQUIRE(i == 7);
+		}
+		REQUIRE(istr.size() == text.size());
+		REQUIRE(istr.read_view(text.size()).str() == text);
+	}
+	t1.join();
+}
+
+TEST_CASE("crc32c") {
+	const std::string check {"123456789"};
+	REQUIRE(inet::crc32c(check.data(), check.size()) == 0xE3069283u);
+	REQUIRE(inet::crc32c(nullptr, 0) == 0);
+	INFO("checksums continue over several buffers");
+	REQUIRE(inet::crc32c(check.data() + 4, 5, inet::crc32c(check.data(), 4)) == 0xE3069283u);
+	std::vector<inet::byte> data(1000);
+	for (std::size_t i {0}; i < data.size(); ++i) {
+		data[i] = static_cast<inet::byte>(i * 7 + i / 13);
+	}
+	for (std::size_t n : {0, 1, 3, 8, 15, 64, 999, 1000}) {
+		uint32_t table = ~inet::crc32c_scalar(data.data(), n, ~0u);
+		REQUIRE(inet::crc32c(data.data(), n) == table);
+#ifdef INET_X86_SIMD
+		if (__builtin_cpu_supports("sse4.2")) {
+			REQUIRE(~inet::crc32c_sse42(data.data(), n, ~0u) == table);
+		}
+#endif
+	}
+}
+
+TEST_CASE("checksummed messages") {
+	const std::string text(2000, 'x');
+	std::thread t1 {[&text] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3277};
+		auto istr = client.connect();
+		istr.set_checksum(true);
+		istr << 42 << std::string {"checked"};
+		istr.send_message();
+		auto shared = std::make_shared<std::string>(text);
+		istr << 7;
+		istr.write_ref(shared);
+		istr.send_message();
+		istr.set_codec(std::make_shared<inet::lz_codec>(), 64);
+		istr << text;
+		istr.send_message();
+		INFO("a message corrupted on the way");
+		istr << static_cast<uint32_t>(0x40000000u | 8) << static_cast<uint32_t>(inet::crc32c("abcd", 4))
+		     << 'a' << 'b' << 'c' << 'e';
+		istr.send();
+		istr.set_codec(nullptr);
+		istr << 43;
+		istr.send_message();
+	}};
+	inet::server<inet::protocol::TCP> server {3277};
+	auto istr = server.accept();
+	int i {};
+	std::string s;
+	REQUIRE(istr.recv_message());
+	istr >> i;
+	istr >> s;
+	REQUIRE(i == 42);
+	REQUIRE(s == "checked");
+	REQUIRE(istr.size() == 0);
+	REQUIRE(istr.recv_message());
+	istr >> i;
+	REQUIRE(i == 7);
+	REQUIRE(istr.read_view(text.size()).str() == text);
+	REQUIRE(istr.recv_message());
+	REQUIRE(istr.size() == text.size());
+	REQUIRE(istr.read_view(text.size()).str() == text);
+	REQUIRE_THROWS_AS(istr.recv_message(), std::runtime_error);
+	REQUIRE(istr.recv_message());
+	istr >> i;
+	REQUIRE(i == 43);
+	t1.join();
+}
+
+TEST_CASE("checksummed messages of the largest size") {
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3288};
+		auto istr = client.connect();
+		// the header send_message() writes for the largest payload
+		istr << static_cast<uint32_t>(0x40000000u | (INET_MAX_MESSAGE_SIZE + 4));
+		istr.send();
+		auto over = client.connect();
+		over << static_cast<uint32_t>(0x40000000u | (INET_MAX_MESSAGE_SIZE + 5));
+		over.send();
+		istr.set_checksum(true);
+		std::vector<char> payload(INET_MAX_MESSAGE_SIZE + 1, 'x');
+		istr.write_array(payload.data(), payload.size());
+		REQUIRE_THROWS_WITH(istr.send_message(), "message too large");
+	}};
+	inet::server<inet::protocol::TCP> server {3288};
+	auto istr = server.accept();
+	INFO("the header is accepted, the payload just has not arrived");
+	REQUIRE_FALSE(istr.recv_message(std::chrono::milliseconds {200}));
+	auto over = server.accept();
+	REQUIRE_THROWS_WITH(over.recv_message(std::chrono::milliseconds {1000}), "message too large");
+	t1.join();
+}
+
+TEST_CASE("acceptor pool") {
+	constexpr int clients {16};
+	std::atomic<int> served {0};
+	inet::acceptor_pool pool {3278, 2, 64};
+	REQUIRE(pool.workers() == 2);
+	pool.start([&served](inet::inetstream<inet::protocol::TCP>&& istr) {
+		if (istr.recv(4, std::chrono::milliseconds {1000}) == 4) {
+			int i {};
+			istr >> i;
+			istr << i * 2;
+			istr.send();
+			++served;
+		}
+	});
+	REQUIRE_THROWS_AS(pool.start(nullptr), std::runtime_error);
+	std::vector<std::thread> threads;
+	for (int c {0}; c < clients; ++c) {
+		threads.emplace_back([c] {
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", 3278};
+			auto istr = client.connect();
+			istr << c;
+			istr.send();
+			REQUIRE(istr.recv(4, std::chrono::milliseconds {1000}) == 4);
+			int i {};
+			istr >> i;
+			REQUIRE(i == c * 2);
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	pool.stop();
+	REQUIRE(served == clients);
+}
+
+TEST_CASE("acceptor pool survives accept errors and throwing handlers") {
+	constexpr int clients {6};
+	std::atomic<int> served {0};
+	std::atomic<int> errors {0};
+	inet::acceptor_pool pool {3290, 1, 32};
+	pool.set_error_handler([&errors](std::exception_ptr e) {
+		try {
+			std::rethrow_exception(e);
+		}
+		catch (const std::logic_error&) {
+			++errors;
+		}
+	});
+	auto on_accept = [&served](inet::inetstream<inet::protocol::TCP>&& istr) {
+		if (istr.recv(4, std::chrono::milliseconds {1000}) != 4) {
+			return;
+		}
+		int i {};
+		istr >> i;
+		if (i % 2) {
+			throw std::logic_error {"odd client"};
+		}
+		istr << i;
+		istr.send();
+		++served;
+	};
+	// clients wait in the backlog until the pool starts
+	std::vector<inet::inetstream<inet::protocol::TCP>> conns;
+	for (int c {0}; c < clients; ++c) {
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3290};
+		conns.push_back(client.connect());
+		conns.back() << c;
+		conns.back().send();
+	}
+	auto cpu_time = [] {
+		rusage ru {};
+		getrusage(RUSAGE_SELF, &ru);
+		return std::chrono::seconds {ru.ru_utime.tv_sec + ru.ru_stime.tv_sec} +
+		       std::chrono::microseconds {ru.ru_utime.tv_usec + ru.ru_stime.tv_usec};
+	};
+	{
+		fd_limit low {0};
+		auto cpu_before = cpu_time();
+		pool.start(on_accept);
+		std::this_thread::sleep_for(std::chrono::milliseconds {300});
+		INFO("the worker waits for descriptors instead of spinning");
+		REQUIRE(cpu_time() - cpu_before < std::chrono::milliseconds {150});
+	}
+	for (int c {0}; c < clients; c += 2) {
+		REQUIRE(conns[c].recv(4, std::chrono::milliseconds {2000}) == 4);
+	}
+	pool.stop();
+	REQUIRE(served == clients / 2);
+	REQUIRE(errors == clients / 2);
+}
+
+TEST_CASE("accepting all pending clients") {
+	constexpr int clients {5};
+	inet::server<inet::protocol::TCP> server {3279, 16};
+	REQUIRE_THROWS_AS(server.accept_all(), std::runtime_error);
+	server.set_nonblocking();
+	REQUIRE(server.accept_all().empty());
+	std::vector<inet::inetstream<inet::protocol::TCP>> conns;
+	for (int c {0}; c < clients; ++c) {
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3279};
+		conns.push_back(client.connect());
+		conns.back() << c;
+		conns.back().send();
+	}
+	std::vector<inet::inetstream<inet::protocol::TCP>> accepted;
+	while (accepted.size() < clients) {
+		REQUIRE(server.select(std::chrono::milliseconds {1000}));
+		for (auto& istr : server.accept_all()) {
+			accepted.push_back(std::move(istr));
+		}
+	}
+	std::vector<int> got;
+	for (auto& istr : accepted) {
+		REQUIRE(istr.peer().host() == "127.0.0.1");
+		REQUIRE(istr.peer().port() != 3279);
+		REQUIRE(istr.recv(4, std::chrono::milliseconds {1000}) == 4);
+		int i {};
+		istr >> i;
+		got.push_back(i);
+	}
+	std::sort(got.begin(), got.end());
+	REQUIRE(got == std::vector<int> {0, 1, 2, 3, 4});
+}
+
+TEST_CASE("runtime") {
+	constexpr int clients {8};
+	constexpr int rounds {3};
+	inet::runtime rt {2};
+	REQUIRE(rt.workers() == 2);
+	REQUIRE(rt.current_worker() == inet::runtime::npos);
+	rt.listen(3280, [](inet::inetstream<inet::protocol::TCP>& istr) {
+		while (istr.size() >= 4) {
+			int i {};
+			istr >> i;
+			istr << i + 1;
+		}
+		istr.send();
+	}, 32);
+	rt.start();
+	REQUIRE_THROWS_AS(rt.start(), std::runtime_error);
+	std::vector<std::thread> threads;
+	for (int c {0}; c < clients; ++c) {
+		threads.emplace_back([c] {
+			inet::client<inet::protocol::TCP> client {"127.0.0.1", 3280};
+			auto istr = client.connect();
+			for (int r {0}; r < rounds; ++r) {
+				istr << c * 10 + r;
+				istr.send();
+				REQUIRE(istr.recv(4, std::chrono::milliseconds {1000}) == 4);
+				int i {};
+				istr >> i;
+				REQUIRE(i == c * 10 + r + 1);
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	INFO("closed connections are dropped");
+	for (int tries {0}; rt.connections() > 0 && tries < 100; ++tries) {
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+	}
+	REQUIRE(rt.connections() == 0);
+
+	INFO("tasks queued on one worker are stolen by the other");
+	std::mutex m;
+	std::set<std::size_t> ran_on;
+	std::atomic<int> done {0};
+	std::atomic<std::size_t> posted_on {inet::runtime::npos};
+	rt.post(0, [&] {
+		posted_on = rt.current_worker();
+		for (int k {0}; k < 8; ++k) {
+			rt.spawn([&] {
+				std::this_thread::sleep_for(std::chrono::milliseconds {5});
+				std::lock_guard<std::mutex> lock {m};
+				ran_on.insert(rt.current_worker());
+				++done;
+			});
+		}
+	});
+	for (int tries {0}; done < 8 && tries < 200; ++tries) {
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+	}
+	REQUIRE(done == 8);
+	REQUIRE(posted_on == 0);
+	REQUIRE(ran_on == std::set<std::size_t> {0, 1});
+	rt.stop();
+}
+
+TEST_CASE("racing connects") {
+	auto local = [](unsigned short port) {
+		inet::endpoint e {};
+		e.addr.v4.sin_family = AF_INET;
+		e.addr.v4.sin_port = htons(port);
+		e.addr.v4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		e.len = sizeof e.addr.v4;
+		return e;
+	};
+	// a server whose accept queue is full leaves further connects hanging
+	inet::server<inet::protocol::TCP> stuck {3281, 0};
+	std::vector<int> queued;
+	for (int c {0}; c < 4; ++c) {
+		try {
+			queued.push_back(inet::race_connect({local(3281)},
+			                                    std::chrono::steady_clock::now() + std::chrono::milliseconds {100},
+			                                    std::chrono::milliseconds {100}));
+		}
+		catch (const std::runtime_error&) {
+			break;
+		}
+	}
+	inet::server<inet::protocol::TCP> server {3282};
+	std::size_t winner {9};
+	auto start = std::chrono::steady_clock::now();
+	int fd = inet::race_connect({local(3281), local(3282)},
+	                            start + std::chrono::milliseconds {2000},
+	                            std::chrono::milliseconds {50}, &winner);
+	auto took = std::chrono::steady_clock::now() - start;
+	REQUIRE(fd != -1);
+	close(fd);
+	REQUIRE(winner == 1);
+	REQUIRE(took < std::chrono::milliseconds {1000});
+	INFO("the deadline bounds how long connect() takes");
+	start = std::chrono::steady_clock::now();
+	// a std::system_error would mean the attempt failed rather than timed out
+	REQUIRE_THROWS_WITH(inet::race_connect({local(3281)}, start + std::chrono::milliseconds {100},
+	                                       std::chrono::milliseconds {50}), "timeout reached");
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds {1000});
+	INFO("refused addresses are skipped without waiting");
+	start = std::chrono::steady_clock::now();
+	fd = inet::race_connect({local(3283), local(3282)}, start + std::chrono::milliseconds {2000},
+	                        std::chrono::milliseconds {1000}, &winner);
+	close(fd);
+	REQUIRE(winner == 1);
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds {500});
+	REQUIRE_THROWS_AS(inet::race_connect({local(3283)}, start + std::chrono::milliseconds {2000},
+	                                     std::chrono::milliseconds {50}), std::system_error);
+	for (int q : queued) {
+		close(q);
+	}
+	inet::client<inet::protocol::TCP> client {"localhost", 3282};
+	auto istr = client.connect(std::chrono::milliseconds {1000});
+	REQUIRE(istr.peer().host() == "127.0.0.1");
+	REQUIRE(istr.peer().port() == 3282);
+}
+
+TEST_CASE("recv gives up at its deadline while data keeps coming") {
+	constexpr std::size_t sz {8 * 1024 * 1024};
+	std::thread t1 {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3285};
+		auto istr = client.connect();
+		istr << std::vector<inet::byte>(sz);
+		try {
+			istr.send();
+		}
+		catch (const std::exception&) {
+			// the receiver hung up before taking everything
+		}
+	}};
+	inet::server<inet::protocol::TCP> server {3285};
+	auto istr = server.accept();
+	REQUIRE(istr.recv(1, std::chrono::milliseconds {1000}) == 1);
+	// single byte reads, so there is always more data waiting than one
+	// read takes
+	istr.set_read_size(1);
+	auto start = std::chrono::steady_clock::now();
+	std::size_t got = istr.recv(sz, std::chrono::milliseconds {20});
+	auto took = std::chrono::steady_clock::now() - start;
+	istr.set_read_size(INET_DEFAULT_READ_SIZE);
+	while (got + 1 < sz && istr.recv(sz - 1 - got, std::chrono::milliseconds {1000}) > 0) {
+		got = istr.size() - 1;
+	}
+	t1.join();
+	REQUIRE(took < std::chrono::milliseconds {500});
+}
+
+TEST_CASE("runtime survives running out of descriptors and throwing tasks") {
+	constexpr int clients {8};
+	inet::runtime rt {1};
+	std::atomic<int> errors {0};
+	std::atomic<int> thrown {0};
+	rt.set_error_handler([&errors, &thrown](std::exception_ptr e) {
+		try {
+			std::rethrow_exception(e);
+		}
+		catch (const std::logic_error&) {
+			++errors;
+		}
+		catch (int) {
+			++thrown;
+		}
+	});
+	rt.listen(3286, [](inet::inetstream<inet::protocol::TCP>& istr) {
+		while (istr.size() >= 4) {
+			int i {};
+			istr >> i;
+			istr << i + 1;
+		}
+		istr.send();
+	}, 32);
+	// clients wait in the backlog until the runtime starts
+	std::vector<inet::inetstream<inet::protocol::TCP>> conns;
+	for (int c {0}; c < clients; ++c) {
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3286};
+		conns.push_back(client.connect());
+	}
+	std::size_t while_low {0};
+	{
+		// room for a couple of clients only
+		fd_limit low {3};
+		rt.start();
+		std::this_thread::sleep_for(std::chrono::milliseconds {150});
+		while_low = rt.connections();
+	}
+	REQUIRE(while_low < clients);
+	for (int tries {0}; rt.connections() < clients && tries < 100; ++tries) {
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+	}
+	REQUIRE(rt.connections() == clients);
+	for (int c {0}; c < clients; ++c) {
+		conns[c] << c;
+		conns[c].send();
+		REQUIRE(conns[c].recv(4, std::chrono::milliseconds {1000}) == 4);
+		int i {};
+		conns[c] >> i;
+		REQUIRE(i == c + 1);
+	}
+	INFO("exceptions of tasks go to the error handler");
+	rt.spawn([] { throw std::logic_error {"task failed"}; });
+	rt.post(0, [] { throw std::logic_error {"posted task failed"}; });
+	std::atomic<bool> ran {false};
+	rt.spawn([&ran] { ran = true; });
+	for (int tries {0}; (!ran || errors < 2) && tries < 100; ++tries) {
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+	}
+	REQUIRE(errors == 2);
+	REQUIRE(ran);
+	INFO("so does anything a connection handler throws, which closes the connection");
+	rt.listen(3292, [](inet::inetstream<inet::protocol::TCP>&) { throw 42; });
+	inet::client<inet::protocol::TCP> client {"127.0.0.1", 3292};
+	auto istr = client.connect();
+	istr << 1;
+	istr.send();
+	REQUIRE(istr.recv(4, std::chrono::milliseconds {1000}) == 0);
+	REQUIRE(istr.eof());
+	REQUIRE(thrown == 1);
+	rt.stop();
+}
+
+TEST_CASE("runtime serves a flooding connection in bounded turns") {
+	constexpr std::size_t flood {16 * 1024 * 1024};
+	inet::runtime rt {1};
+	std::atomic<std::size_t> most {0};
+	std::atomic<std::size_t> flooded {0};
+	// zeros are discarded, anything else is answered
+	rt.listen(3287, [&](inet::inetstream<inet::protocol::TCP>& istr) {
+		most = std::max<std::size_t>(most, istr.size());
+		bool reply {false};
+		while (istr.size() >= 4) {
+			int i {};
+			istr >> i;
+			if (i != 0) {
+				istr << i + 1;
+				reply = true;
+			}
+			else {
+				flooded += 4;
+			}
+		}
+		if (reply) {
+			istr.send();
+		}
+	}, 32);
+	rt.start();
+	inet::client<inet::protocol::TCP> client {"127.0.0.1", 3287};
+	auto flooder = client.connect();
+	auto pinger = client.connect();
+	std::thread t {[&flooder] {
+		std::vector<char> zeros(flood);
+		flooder.write_array(zeros.data(), zeros.size());
+		flooder.send();
+	}};
+	for (int r {1}; r <= 5; ++r) {
+		pinger << r;
+		pinger.send();
+		REQUIRE(pinger.recv(4, std::chrono::milliseconds {2000}) == 4);
+		int i {};
+		pinger >> i;
+		REQUIRE(i == r + 1);
+	}
+	t.join();
+	for (int tries {0}; flooded < flood && tries < 500; ++tries) {
+		std::this_thread::sleep_for(std::chrono::milliseconds {10});
+	}
+	REQUIRE(flooded == flood);
+	INFO("no more than the read budget is received per turn");
+	REQUIRE(most <= 256 * 1024 + 3);
+	rt.stop();
+}
+
+TEST_CASE("event_loop keeps accepting after accept errors") {
+	constexpr std::size_t clients {6};
+	inet::server<inet::protocol::TCP> server {3289, 32};
+	inet::event_loop loop;
+	std::vector<inet::inetstream<inet::protocol::TCP>> accepted;
+	loop.add(server, [&accepted](inet::inetstream<inet::protocol::TCP>&& istr) {
+		accepted.push_back(std::move(istr));
+	});
+	abort_connect(3289);
+	std::vector<inet::inetstream<inet::protocol::TCP>> conns;
+	for (std::size_t c {0}; c < clients; ++c) {
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3289};
+		conns.push_back(client.connect());
+	}
+	{
+		fd_limit low {3};
+		REQUIRE_NOTHROW(loop.run_once(std::chrono::milliseconds {100}));
+	}
+	std::size_t while_low = accepted.size();
+	REQUIRE(while_low < clients);
+	INFO("the stalled server is retried without a new client");
+	auto start = std::chrono::steady_clock::now();
+	loop.run_once(std::chrono::milliseconds {5000});
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds {1000});
+	REQUIRE(accepted.size() > while_low);
+	for (int tries {0}; accepted.size() < clients && tries < 20; ++tries) {
+		loop.run_once(std::chrono::milliseconds {50});
+	}
+	// the aborted client may or may not be accepted
+	REQUIRE(accepted.size() >= clients);
+	loop.remove(server);
+}
+
+TEST_CASE("event_loop returns when a signal interrupts it") {
+	// installs the SIGUSR1 handler
+	inet::server<inet::protocol::TCP> server {3291};
+	inet::event_loop loop;
+	loop.add(server, [](inet::inetstream<inet::protocol::TCP>&&) {});
+	pthread_t self = pthread_self();
+	std::thread t {[self] {
+		std::this_thread::sleep_for(std::chrono::milliseconds {50});
+		pthread_kill(self, SIGUSR1);
+	}};
+	auto start = std::chrono::steady_clock::now();
+	std::size_t n {1};
+	REQUIRE_NOTHROW(n = loop.run_once(std::chrono::milliseconds {2000}));
+	t.join();
+	REQUIRE(n == 0);
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds {1000});
+	loop.remove(server);
+}
@@ -31,12 +31,93 @@ TEST_CASE("test client -> server message") {
 	}
 }
 
-// server cannot send to client, this test will loop endlessly
-/*
+TEST_CASE("sending and receiving datagrams in batches") {
+	inet::server<inet::protocol::UDP> server {1341};
+	auto sistr = server.get_inetstream();
+	std::thread t {[] {
+		inet::client<inet::protocol::UDP> client {"127.0.0.1", 1341};
+		auto istr = client.get_inetstream();
+		istr << 1;
+		istr.queue_datagram();
+		istr << 2 << 3;
+		istr.queue_datagram();
+		istr << std::string {"three"};
+		REQUIRE(istr.send_batch() == 3);
+		REQUIRE(istr.empty());
+	}};
+	t.join();
+	std::size_t got {0};
+	while (got < 3) {
+		std::size_t n = sistr.recv_batch(8, std::chrono::milliseconds {100});
+		REQUIRE(n > 0);
+		got += n;
+	}
+	int i {};
+	REQUIRE(sistr.next_datagram());
+	REQUIRE(sistr.size() == 4);
+	sistr >> i;
+	REQUIRE(i == 1);
+	REQUIRE(sistr.peer().host() == "127.0.0.1");
+	// the unread second int is skipped
+	REQUIRE(sistr.next_datagram());
+	REQUIRE(sistr.size() == 8);
+	sistr >> i;
+	REQUIRE(i == 2);
+	REQUIRE(sistr.next_datagram());
+	REQUIRE(sistr.size() == 5);
+	std::string s;
+	sistr >> s;
+	REQUIRE(s == "three");
+	REQUIRE_FALSE(sistr.next_datagram());
+}
+
+namespace {
+// remembers the largest buffer handed out
+struct watching_pool : inet::buffer_pool {
+	std::size_t largest {0};
+	void* allocate(std::size_t sz) override {
+		largest = std::max(largest, sz);
+		return inet::buffer_pool::allocate(sz);
+	}
+};
+}
+TEST_CASE("large batches with a large read size") {
+	constexpr int datagrams {40};
+	inet::server<inet::protocol::UDP> server {1345};
+	auto sistr = server.get_inetstream();
+	auto pool = std::make_shared<watching_pool>();
+	sistr.set_buffer_pool(pool);
+	sistr.set_read_size(4 * 1024 * 1024);
+	inet::client<inet::protocol::UDP> client {"127.0.0.1", 1345};
+	auto istr = client.get_inetstream();
+	for (int i {0}; i < datagrams; ++i) {
+		istr << i;
+		istr.queue_datagram();
+	}
+	REQUIRE(istr.send_batch() == datagrams);
+	int got {0};
+	while (got < datagrams) {
+		std::size_t n = sistr.recv_batch(1024, std::chrono::milliseconds {100});
+		REQUIRE(n > 0);
+		while (sistr.next_datagram()) {
+			int i {};
+			sistr >> i;
+			REQUIRE(i == got++);
+		}
+	}
+	INFO("room is set aside for the largest datagram at most, within the batch limit");
+	REQUIRE(pool->largest <= 2 * INET_MAX_BATCH_SIZE);
+}
+
 TEST_CASE("server -> client") {
+	inet::server<inet::protocol::UDP> server {1342};
+	auto sistr = server.get_inetstream();
 	std::thread t {[] {
-		inet::client<inet::protocol::UDP> client {"127.0.0.1", 1337};
+		inet::client<inet::protocol::UDP> client {"127.0.0.1", 1342};
 		auto istr = client.get_inetstream();
+		// the server only learns about the client from its datagrams
+		istr << 41;
+		istr.send();
 		do {
 			if (istr.select(std::chrono::milliseconds {100}))
 				istr.recv();
@@ -47,13 +128,12 @@ TEST_CASE("server -> client") {
 		REQUIRE(i == 42);
 	}};
 	try {
-		inet::server<inet::protocol::UDP> server {1337};
-		auto istr = server.get_inetstream();
-		std::this_thread::sleep_for(std::chrono::milliseconds{10});
-		istr << 42;
-		istr.send();
-		std::this_thread::sleep_for(std::chrono::milliseconds{50});
-		istr.clear();
+		sistr.recv();
+		REQUIRE(sistr.size() == 4);
+		int i {};
+		sistr >> i;
+		sistr << i + 1;
+		sistr.reply();
 		t.join();
 	}
 	catch (const std::exception& e)
@@ -61,4 +141,77 @@ TEST_CASE("server -> client") {
 		std::cout << "caught exception: " << e.what() << std::endl;
 	}
 }
-*/
+
+TEST_CASE("replying to a batch of clients") {
+	constexpr int clients {4};
+	inet::server<inet::protocol::UDP> server {1343};
+	auto sistr = server.get_inetstream();
+	REQUIRE_THROWS_AS(sistr.reply(), std::runtime_error);
+	std::vector<std::thread> threads;
+	for (int c {0}; c < clients; ++c) {
+		threads.emplace_back([c] {
+			inet::client<inet::protocol::UDP> client {"127.0.0.1", 1343};
+			auto istr = client.get_inetstream();
+			istr << c;
+			istr.send();
+			REQUIRE(istr.select(std::chrono::milliseconds {1000}));
+			istr.recv();
+			int i {};
+			istr >> i;
+			REQUIRE(i == c * 10);
+		});
+	}
+	int got {0};
+	while (got < clients) {
+		REQUIRE(sistr.recv_batch(clients, std::chrono::milliseconds {1000}) > 0);
+		while (sistr.next_datagram()) {
+			int i {};
+			sistr >> i;
+			sistr << i * 10;
+			sistr.queue_datagram(sistr.peer());
+			++got;
+		}
+		sistr.send_batch();
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+}
+
+TEST_CASE("checksummed datagrams") {
+	inet::server<inet::protocol::UDP> server {1344};
+	auto sistr = server.get_inetstream();
+	sistr.set_checksum(true);
+	std::thread t {[] {
+		inet::client<inet::protocol::UDP> client {"127.0.0.1", 1344};
+		auto istr = client.get_inetstream();
+		istr << 1;
+		istr.send();
+		istr.clear();
+		// wrong checksum, as if changed on the way
+		istr << 2 << 0;
+		istr.send();
+		istr.clear();
+		istr.set_checksum(true);
+		istr << 3;
+		istr.queue_datagram();
+		istr << 4;
+		REQUIRE(istr.send_batch() == 2);
+	}};
+	t.join();
+	std::size_t got {0};
+	while (got < 2) {
+		REQUIRE(sistr.select(std::chrono::milliseconds {100}));
+		got += sistr.recv_batch(8, std::chrono::milliseconds {100});
+	}
+	REQUIRE(sistr.checksum_failures() == 2);
+	int i {};
+	REQUIRE(sistr.next_datagram());
+	REQUIRE(sistr.size() == 4);
+	sistr >> i;
+	REQUIRE(i == 3);
+	REQUIRE(sistr.next_datagram());
+	sistr >> i;
+	REQUIRE(i == 4);
+	REQUIRE_FALSE(sistr.next_datagram());
+}
@@ -0,0 +1,100 @@
+#include "Catch2/include/catch.hpp"
+
+#define INET_USE_DEFAULT_SIGUSR1_HANDLER true
+#define INET_USE_IO_URING
+#include "../inetstream.hpp"
+
+#include <thread>
+#include <chrono>
+#include <netinet/in.h>
+
+TEST_CASE("uring accept, recv and send") {
+	std::thread t {[] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+		inet::client<inet::protocol::TCP> client {"127.0.0.1", 3600};
+		auto istr = client.connect();
+		istr << 1 << 2;
+		istr.send();
+		istr.recv(4);
+		REQUIRE(istr.size() == 4);
+		int i {};
+		istr >> i;
+		REQUIRE(i == 3);
+	}};
+	inet::server<inet::protocol::TCP> server {3600};
+	inet::uring ring;
+	std::unique_ptr<inet::inetstream<inet::protocol::TCP>> conn;
+	bool done {false};
+	std::function<void(std::error_code, std::size_t)> on_recv = [&](std::error_code ec, std::size_t) {
+		REQUIRE_FALSE(ec);
+		if (conn->size() < 8) {
+			ring.async_recv(*conn, 8 - conn->size(), on_recv);
+			return;
+		}
+		int a {}, b {};
+		*conn >> a;
+		*conn >> b;
+		*conn << a + b;
+		ring.async_send(*conn, [&](std::error_code ec, std::size_t sent) {
+			REQUIRE_FALSE(ec);
+			REQUIRE(sent == 4);
+			done = true;
+		});
+	};
+	ring.async_accept(server, [&](std::error_code ec, inet::inetstream<inet::protocol::TCP>&& istr) {
+		REQUIRE_FALSE(ec);
+		conn.reset(new inet::inetstream<inet::protocol::TCP> {std::move(istr)});
+		ring.async_recv(*conn, 8, on_recv);
+	});
+	REQUIRE(ring.pending() == 1);
+	int rounds {0};
+	while (!done && ++rounds < 100) {
+		ring.run_once(std::chrono::milliseconds {100});
+	}
+	REQUIRE(done);
+	REQUIRE(ring.pending() == 0);
+	ring.remove(*conn);
+	ring.remove(server);
+	t.join();
+}
+
+TEST_CASE("uring hands errors to the handler") {
+	inet::server<inet::protocol::TCP> server {3601};
+	inet::uring ring;
+	std::unique_ptr<inet::inetstream<inet::protocol::TCP>> conn;
+	std::error_code error;
+	bool done {false};
+	ring.async_accept(server, [&](std::error_code ec, inet::inetstream<inet::protocol::TCP>&& istr) {
+		REQUIRE_FALSE(ec);
+		conn.reset(new inet::inetstream<inet::protocol::TCP> {std::move(istr)});
+		ring.async_recv(*conn, 4, [&](std::error_code ec, std::size_t n) {
+			error = ec;
+			REQUIRE(n == 0);
+			done = true;
+		});
+	});
+	// connect and reset the connection
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	REQUIRE(fd != -1);
+	sockaddr_in addr {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(3601);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == 0);
+	for (int r {0}; !conn && r < 100; ++r) {
+		ring.run_once(std::chrono::milliseconds {100});
+	}
+	REQUIRE(conn);
+	linger l {1, 0};
+	REQUIRE(setsockopt(fd, SOL_SOCKET, SO_LINGER, &l, sizeof l) == 0);
+	close(fd);
+	int rounds {0};
+	while (!done && ++rounds < 100) {
+		REQUIRE_NOTHROW(ring.run_once(std::chrono::milliseconds {100}));
+	}
+	REQUIRE(done);
+	REQUIRE(error.value() == ECONNRESET);
+	REQUIRE_FALSE(conn->eof());
+	ring.remove(*conn);
+	ring.remove(server);
+}